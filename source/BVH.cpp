@@ -0,0 +1,251 @@
+#include "BVH.h"
+
+#include <numeric>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		Clear();
+
+		const uint32_t primitiveCount{ static_cast<uint32_t>(primitiveBounds.size()) };
+		if (primitiveCount == 0)
+			return;
+
+		m_PrimitiveIndices.resize(primitiveCount);
+		std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0u);
+
+		std::vector<Vector3> centroids{};
+		centroids.reserve(primitiveCount);
+		for (const AABB& bounds : primitiveBounds)
+		{
+			centroids.emplace_back(bounds.Center());
+		}
+
+		//A binary tree with n leaves never needs more than 2n - 1 nodes
+		m_Nodes.reserve(2 * size_t(primitiveCount) - 1);
+
+		BVHNode& root{ m_Nodes.emplace_back() };
+		root.leftFirst = 0;
+		root.primitiveCount = primitiveCount;
+		UpdateNodeBounds(root, primitiveBounds);
+
+		Subdivide(primitiveBounds, centroids);
+
+		m_Nodes.shrink_to_fit();
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		assert(primitiveBounds.size() == m_PrimitiveIndices.size() && "Refit needs the same primitives the BVH was built with");
+
+		//Children are always stored after their parent, so walking backwards visits them first
+		for (size_t nodeIndex{ m_Nodes.size() }; nodeIndex-- > 0;)
+		{
+			BVHNode& node{ m_Nodes[nodeIndex] };
+			if (node.IsLeaf())
+			{
+				UpdateNodeBounds(node, primitiveBounds);
+				continue;
+			}
+
+			const BVHNode& left{ m_Nodes[node.leftFirst] };
+			const BVHNode& right{ m_Nodes[node.leftFirst + 1] };
+			node.boundsMin = { std::min(left.boundsMin.x, right.boundsMin.x), std::min(left.boundsMin.y, right.boundsMin.y), std::min(left.boundsMin.z, right.boundsMin.z) };
+			node.boundsMax = { std::max(left.boundsMax.x, right.boundsMax.x), std::max(left.boundsMax.y, right.boundsMax.y), std::max(left.boundsMax.z, right.boundsMax.z) };
+		}
+	}
+
+	float BVH::GetCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.f;
+
+		const float rootArea{ GetSurfaceArea(m_Nodes[0]) };
+		if (rootArea <= 0.f)
+			return GetLeafCost(GetPrimitiveCount());
+
+		float cost{};
+		for (const BVHNode& node : m_Nodes)
+		{
+			cost += GetSurfaceArea(node) * (node.IsLeaf() ? GetLeafCost(node.primitiveCount) : TRAVERSAL_COST);
+		}
+		return cost / rootArea;
+	}
+
+	void BVH::Clear()
+	{
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+	}
+
+	void BVH::Assign(std::vector<BVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices)
+	{
+		assert((nodes.empty() || nodes[0].IsLeaf() || nodes.size() >= 3) && "Not a tree Build made");
+		m_Nodes = std::move(nodes);
+		m_PrimitiveIndices = std::move(primitiveIndices);
+	}
+
+	void BVH::UpdateNodeBounds(BVHNode& node, const std::vector<AABB>& primitiveBounds) const
+	{
+		AABB bounds{};
+		for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.primitiveCount; ++index)
+		{
+			bounds.Grow(primitiveBounds[m_PrimitiveIndices[index]]);
+		}
+
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+
+	BVH::Split BVH::FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids) const
+	{
+		struct Bin
+		{
+			AABB bounds{};
+			uint32_t count{};
+		};
+
+		AABB centroidBounds{};
+		for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.primitiveCount; ++index)
+		{
+			centroidBounds.Grow(centroids[m_PrimitiveIndices[index]]);
+		}
+
+		Split bestSplit{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float centroidMin{ centroidBounds.min[axis] };
+			const float centroidMax{ centroidBounds.max[axis] };
+			if (centroidMin == centroidMax)
+				continue;
+
+			//Sort the primitives into equally sized bins along the axis
+			Bin bins[BIN_COUNT]{};
+			const float binScale{ BIN_COUNT / (centroidMax - centroidMin) };
+			for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.primitiveCount; ++index)
+			{
+				const uint32_t primitiveIndex{ m_PrimitiveIndices[index] };
+				const int binIndex{ std::min(BIN_COUNT - 1, static_cast<int>((centroids[primitiveIndex][axis] - centroidMin) * binScale)) };
+
+				bins[binIndex].bounds.Grow(primitiveBounds[primitiveIndex]);
+				++bins[binIndex].count;
+			}
+
+			//Sweep from both sides to get area and count left and right of every plane between two bins
+			float leftArea[BIN_COUNT - 1]{}, rightArea[BIN_COUNT - 1]{};
+			uint32_t leftCount[BIN_COUNT - 1]{}, rightCount[BIN_COUNT - 1]{};
+			AABB leftBounds{}, rightBounds{};
+			uint32_t leftSum{}, rightSum{};
+			for (int plane{}; plane < BIN_COUNT - 1; ++plane)
+			{
+				leftSum += bins[plane].count;
+				leftCount[plane] = leftSum;
+				leftBounds.Grow(bins[plane].bounds);
+				leftArea[plane] = leftBounds.SurfaceArea();
+
+				rightSum += bins[BIN_COUNT - 1 - plane].count;
+				rightCount[BIN_COUNT - 2 - plane] = rightSum;
+				rightBounds.Grow(bins[BIN_COUNT - 1 - plane].bounds);
+				rightArea[BIN_COUNT - 2 - plane] = rightBounds.SurfaceArea();
+			}
+
+			for (int plane{}; plane < BIN_COUNT - 1; ++plane)
+			{
+				if (leftCount[plane] == 0 || rightCount[plane] == 0)
+					continue;
+
+				const float cost{ GetLeafCost(leftCount[plane]) * leftArea[plane] + GetLeafCost(rightCount[plane]) * rightArea[plane] };
+				if (cost < bestSplit.cost)
+				{
+					bestSplit.axis = axis;
+					bestSplit.bin = plane;
+					bestSplit.centroidMin = centroidMin;
+					bestSplit.binScale = binScale;
+					bestSplit.cost = cost;
+				}
+			}
+		}
+
+		return bestSplit;
+	}
+
+	void BVH::Subdivide(const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids)
+	{
+		struct BuildEntry
+		{
+			uint32_t nodeIndex;
+			int depth;
+		};
+
+		std::vector<BuildEntry> buildStack{ { 0, 0 } };
+		while (!buildStack.empty())
+		{
+			const BuildEntry entry{ buildStack.back() };
+			buildStack.pop_back();
+
+			BVHNode& node{ m_Nodes[entry.nodeIndex] };
+			if (node.primitiveCount <= 1 || entry.depth >= MAX_DEPTH - 2)
+				continue;
+
+			const Split split{ FindBestSplit(node, primitiveBounds, centroids) };
+			if (split.axis < 0)
+				continue;
+
+			//SAH: expected cost of testing both children against testing everything in this node
+			const float parentArea{ GetSurfaceArea(node) };
+			const float splitCost{ TRAVERSAL_COST + split.cost / parentArea };
+			const float leafCost{ GetLeafCost(node.primitiveCount) };
+			if (splitCost >= leafCost && node.primitiveCount <= std::max(MAX_LEAF_SIZE, m_LeafBatchSize))
+				continue;
+
+			//Partition the index range in place
+			uint32_t first{ node.leftFirst };
+			uint32_t last{ node.leftFirst + node.primitiveCount - 1 };
+			while (first <= last)
+			{
+				const float centroid{ centroids[m_PrimitiveIndices[first]][split.axis] };
+				const int binIndex{ std::min(BIN_COUNT - 1, static_cast<int>((centroid - split.centroidMin) * split.binScale)) };
+				if (binIndex <= split.bin)
+				{
+					++first;
+				}
+				else
+				{
+					std::swap(m_PrimitiveIndices[first], m_PrimitiveIndices[last]);
+					if (last == 0)
+						break;
+					--last;
+				}
+			}
+
+			const uint32_t leftCount{ first - node.leftFirst };
+			if (leftCount == 0 || leftCount == node.primitiveCount)
+				continue;
+
+			const uint32_t leftIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+			const uint32_t primitiveFirst{ node.leftFirst };
+			const uint32_t primitiveCount{ node.primitiveCount };
+
+			//Turn the node into an interior node before growing the array, the reference is invalid afterwards
+			node.leftFirst = leftIndex;
+			node.primitiveCount = 0;
+
+			BVHNode left{};
+			left.leftFirst = primitiveFirst;
+			left.primitiveCount = leftCount;
+			UpdateNodeBounds(left, primitiveBounds);
+
+			BVHNode right{};
+			right.leftFirst = primitiveFirst + leftCount;
+			right.primitiveCount = primitiveCount - leftCount;
+			UpdateNodeBounds(right, primitiveBounds);
+
+			m_Nodes.push_back(left);
+			m_Nodes.push_back(right);
+
+			buildStack.push_back({ leftIndex + 1, entry.depth + 1 });
+			buildStack.push_back({ leftIndex, entry.depth + 1 });
+		}
+	}
+}
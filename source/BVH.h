@@ -0,0 +1,369 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "RayStats.h"
+
+namespace dae
+{
+	template<int Lanes>
+	struct RayPacket;
+
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			min = { std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z) };
+			max = { std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z) };
+		}
+
+		void Grow(const AABB& other)
+		{
+			if (other.IsEmpty())
+				return;
+
+			Grow(other.min);
+			Grow(other.max);
+		}
+
+		bool IsEmpty() const
+		{
+			return min.x > max.x;
+		}
+
+		Vector3 Center() const
+		{
+			return (min + max) * 0.5f;
+		}
+
+		float SurfaceArea() const
+		{
+			if (IsEmpty())
+				return 0.f;
+
+			const Vector3 extent{ max - min };
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+	};
+
+	//32 bytes, two nodes share a cache line
+	//Interior nodes: leftFirst is the index of the left child, the right child always follows it
+	//Leaf nodes: leftFirst is the first entry in the primitive index list
+	struct BVHNode
+	{
+		Vector3 boundsMin{};
+		uint32_t leftFirst{};
+		Vector3 boundsMax{};
+		uint32_t primitiveCount{};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	//Bounding volume hierarchy over a list of primitive bounds
+	//Built top-down with a binned surface area heuristic and flattened into a single node array.
+	//The BVH never touches the primitives themselves: leaves hand out ranges of GetPrimitiveIndices()
+	//and the caller tests whatever those indices refer to.
+	//Traversal takes any ray type with origin, direction, min and max (Ray), so this header doesn't depend on DataTypes.h.
+	class BVH final
+	{
+	public:
+		BVH() = default;
+		~BVH() = default;
+
+		void Build(const std::vector<AABB>& primitiveBounds);
+		//Recomputes every node's bounds bottom-up without changing the topology, the primitive count must not change
+		void Refit(const std::vector<AABB>& primitiveBounds);
+		void Clear();
+		//Takes over a tree an earlier Build made, e.g. one read back from the MeshCache
+		void Assign(std::vector<BVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices);
+
+		//Primitives the leaf callback tests in one go (SIMD width), leaves are costed per batch instead of per primitive
+		void SetLeafBatchSize(uint32_t batchSize) { m_LeafBatchSize = std::max(batchSize, 1u); }
+		uint32_t GetLeafBatchSize() const { return m_LeafBatchSize; }
+
+		//SAH cost of the whole tree: expected traversal and primitive tests per ray that hits the root
+		//Refitting keeps the topology, so this grows as the primitives move away from where they were at build time
+		float GetCost() const;
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		uint32_t GetPrimitiveCount() const { return static_cast<uint32_t>(m_PrimitiveIndices.size()); }
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+		/**
+		 * \brief Closest-hit traversal, visits the nearest child first and skips everything beyond maxT
+		 * \param ray ray to trace
+		 * \param maxT current closest distance, re-read after every leaf so the callback can shrink it
+		 * \param intersectLeaf void(uint32_t first, uint32_t count), tests GetPrimitiveIndices()[first, first + count)
+		 */
+		template<typename RayType, typename LeafFunction>
+		void Intersect(const RayType& ray, const float& maxT, LeafFunction&& intersectLeaf) const;
+
+		/**
+		 * \brief Any-hit traversal for occlusion, visits the larger child first and stops at the first leaf that reports a hit
+		 * \param ray ray to trace, only [ray.min, ray.max] is considered
+		 * \param intersectLeaf bool(uint32_t first, uint32_t count), returns true if any primitive in the range is hit
+		 * \return true if a hit was reported
+		 */
+		template<typename RayType, typename LeafFunction>
+		bool IntersectAny(const RayType& ray, LeafFunction&& intersectLeaf) const;
+
+		/**
+		 * \brief Closest-hit traversal for a packet, a node is entered when any active lane hits it closer than that lane's maxT
+		 * \param packet rays to trace
+		 * \param maxT current closest distance per lane, re-read after every leaf
+		 * \param intersectLeaf void(uint32_t first, uint32_t count), tests the packet against the range
+		 */
+		template<int Lanes, typename LeafFunction>
+		void IntersectPacket(const RayPacket<Lanes>& packet, const float (&maxT)[Lanes], LeafFunction&& intersectLeaf) const;
+
+		static constexpr int MAX_DEPTH{ 64 };
+
+	private:
+		static constexpr int BIN_COUNT{ 12 };
+		static constexpr uint32_t MAX_LEAF_SIZE{ 8 };
+		static constexpr float TRAVERSAL_COST{ 1.f }; //relative to one primitive test
+
+		struct Split
+		{
+			int axis{ -1 };
+			int bin{};
+			float centroidMin{};
+			float binScale{};
+			float cost{ FLT_MAX };
+		};
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+		uint32_t m_LeafBatchSize{ 1 };
+
+		float GetLeafCost(uint32_t primitiveCount) const { return static_cast<float>((primitiveCount + m_LeafBatchSize - 1) / m_LeafBatchSize); }
+		void UpdateNodeBounds(BVHNode& node, const std::vector<AABB>& primitiveBounds) const;
+		Split FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids) const;
+		void Subdivide(const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids);
+
+		static float IntersectAABB(const Vector3& origin, const Vector3& inverseDirection, float minT, float maxT, const BVHNode& node);
+		static float GetSurfaceArea(const BVHNode& node) { return AABB{ node.boundsMin, node.boundsMax }.SurfaceArea(); }
+
+		//Closest entry distance over the lanes that hit the node, FLT_MAX if none do
+		template<int Lanes>
+		static float IntersectAABB(const RayPacket<Lanes>& packet, const float (&inverseDirectionX)[Lanes], const float (&inverseDirectionY)[Lanes],
+			const float (&inverseDirectionZ)[Lanes], const float (&maxT)[Lanes], const BVHNode& node);
+	};
+
+#pragma region BVH Traversal
+	inline float BVH::IntersectAABB(const Vector3& origin, const Vector3& inverseDirection, float minT, float maxT, const BVHNode& node)
+	{
+		const float tx1{ (node.boundsMin.x - origin.x) * inverseDirection.x };
+		const float tx2{ (node.boundsMax.x - origin.x) * inverseDirection.x };
+		const float ty1{ (node.boundsMin.y - origin.y) * inverseDirection.y };
+		const float ty2{ (node.boundsMax.y - origin.y) * inverseDirection.y };
+		const float tz1{ (node.boundsMin.z - origin.z) * inverseDirection.z };
+		const float tz2{ (node.boundsMax.z - origin.z) * inverseDirection.z };
+
+		const float tEnter{ std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2)) };
+		const float tExit{ std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2)) };
+
+		if (tExit >= tEnter && tEnter <= maxT && tExit >= minT)
+			return tEnter;
+
+		return FLT_MAX;
+	}
+
+	template<typename RayType, typename LeafFunction>
+	void BVH::Intersect(const RayType& ray, const float& maxT, LeafFunction&& intersectLeaf) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+		struct StackEntry
+		{
+			uint32_t nodeIndex;
+			float tEnter;
+		};
+		StackEntry stack[MAX_DEPTH];
+		int stackSize{};
+
+		float tEnter{ IntersectAABB(ray.origin, inverseDirection, ray.min, std::min(maxT, ray.max), m_Nodes[0]) };
+		if (tEnter == FLT_MAX)
+			return;
+
+		stack[stackSize++] = { 0, tEnter };
+		while (stackSize > 0)
+		{
+			const StackEntry entry{ stack[--stackSize] };
+			DAE_COUNT_RAYS(NodeVisits, 1);
+
+			//A closer hit may have been found since this node was pushed
+			if (entry.tEnter > maxT)
+				continue;
+
+			const BVHNode& node{ m_Nodes[entry.nodeIndex] };
+			if (node.IsLeaf())
+			{
+				intersectLeaf(node.leftFirst, node.primitiveCount);
+				continue;
+			}
+
+			const float limitT{ std::min(maxT, ray.max) };
+			uint32_t nearIndex{ node.leftFirst };
+			uint32_t farIndex{ node.leftFirst + 1 };
+			float tNear{ IntersectAABB(ray.origin, inverseDirection, ray.min, limitT, m_Nodes[nearIndex]) };
+			float tFar{ IntersectAABB(ray.origin, inverseDirection, ray.min, limitT, m_Nodes[farIndex]) };
+
+			if (tNear > tFar)
+			{
+				std::swap(nearIndex, farIndex);
+				std::swap(tNear, tFar);
+			}
+
+			//Push far first so the near child is popped next
+			assert(stackSize + 2 <= MAX_DEPTH && "BVH deeper than the traversal stack");
+			if (tFar != FLT_MAX)
+				stack[stackSize++] = { farIndex, tFar };
+			if (tNear != FLT_MAX)
+				stack[stackSize++] = { nearIndex, tNear };
+		}
+	}
+
+	template<typename RayType, typename LeafFunction>
+	bool BVH::IntersectAny(const RayType& ray, LeafFunction&& intersectLeaf) const
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+		uint32_t stack[MAX_DEPTH];
+		int stackSize{};
+
+		if (IntersectAABB(ray.origin, inverseDirection, ray.min, ray.max, m_Nodes[0]) == FLT_MAX)
+			return false;
+
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const BVHNode& node{ m_Nodes[stack[--stackSize]] };
+			DAE_COUNT_RAYS(NodeVisits, 1);
+			if (node.IsLeaf())
+			{
+				if (intersectLeaf(node.leftFirst, node.primitiveCount))
+					return true;
+				continue;
+			}
+
+			//Larger boxes are more likely to contain an occluder, so they are popped first
+			uint32_t smallIndex{ node.leftFirst };
+			uint32_t largeIndex{ node.leftFirst + 1 };
+			if (GetSurfaceArea(m_Nodes[smallIndex]) > GetSurfaceArea(m_Nodes[largeIndex]))
+				std::swap(smallIndex, largeIndex);
+
+			assert(stackSize + 2 <= MAX_DEPTH && "BVH deeper than the traversal stack");
+			if (IntersectAABB(ray.origin, inverseDirection, ray.min, ray.max, m_Nodes[smallIndex]) != FLT_MAX)
+				stack[stackSize++] = smallIndex;
+			if (IntersectAABB(ray.origin, inverseDirection, ray.min, ray.max, m_Nodes[largeIndex]) != FLT_MAX)
+				stack[stackSize++] = largeIndex;
+		}
+		return false;
+	}
+
+	template<int Lanes>
+	float BVH::IntersectAABB(const RayPacket<Lanes>& packet, const float (&inverseDirectionX)[Lanes], const float (&inverseDirectionY)[Lanes],
+		const float (&inverseDirectionZ)[Lanes], const float (&maxT)[Lanes], const BVHNode& node)
+	{
+		const Vector3 toMin{ node.boundsMin - packet.origin };
+		const Vector3 toMax{ node.boundsMax - packet.origin };
+
+		alignas(64) float tEnter[Lanes];
+		for (int lane{}; lane < Lanes; ++lane)
+		{
+			const float tx1{ toMin.x * inverseDirectionX[lane] };
+			const float tx2{ toMax.x * inverseDirectionX[lane] };
+			const float ty1{ toMin.y * inverseDirectionY[lane] };
+			const float ty2{ toMax.y * inverseDirectionY[lane] };
+			const float tz1{ toMin.z * inverseDirectionZ[lane] };
+			const float tz2{ toMax.z * inverseDirectionZ[lane] };
+
+			const float laneEnter{ std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2)) };
+			const float laneExit{ std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2)) };
+
+			const bool isHit{ laneExit >= laneEnter && laneEnter <= std::min(maxT[lane], packet.max) && laneExit >= packet.min };
+			tEnter[lane] = isHit ? laneEnter : FLT_MAX;
+		}
+
+		float closestEnter{ FLT_MAX };
+		for (int lane{}; lane < Lanes; ++lane)
+		{
+			if ((packet.activeMask >> lane) & 1)
+				closestEnter = std::min(closestEnter, tEnter[lane]);
+		}
+		return closestEnter;
+	}
+
+	template<int Lanes, typename LeafFunction>
+	void BVH::IntersectPacket(const RayPacket<Lanes>& packet, const float (&maxT)[Lanes], LeafFunction&& intersectLeaf) const
+	{
+		if (m_Nodes.empty() || packet.activeMask == 0)
+			return;
+
+		alignas(64) float inverseDirectionX[Lanes];
+		alignas(64) float inverseDirectionY[Lanes];
+		alignas(64) float inverseDirectionZ[Lanes];
+		for (int lane{}; lane < Lanes; ++lane)
+		{
+			inverseDirectionX[lane] = 1.f / packet.directionX[lane];
+			inverseDirectionY[lane] = 1.f / packet.directionY[lane];
+			inverseDirectionZ[lane] = 1.f / packet.directionZ[lane];
+		}
+
+		const auto intersectNode = [&](uint32_t nodeIndex)
+			{
+				return IntersectAABB(packet, inverseDirectionX, inverseDirectionY, inverseDirectionZ, maxT, m_Nodes[nodeIndex]);
+			};
+
+		uint32_t stack[MAX_DEPTH];
+		int stackSize{};
+
+		if (intersectNode(0) == FLT_MAX)
+			return;
+
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const BVHNode& node{ m_Nodes[stack[--stackSize]] };
+			DAE_COUNT_RAYS(NodeVisits, std::popcount(packet.activeMask));
+			if (node.IsLeaf())
+			{
+				intersectLeaf(node.leftFirst, node.primitiveCount);
+				continue;
+			}
+
+			uint32_t nearIndex{ node.leftFirst };
+			uint32_t farIndex{ node.leftFirst + 1 };
+			float tNear{ intersectNode(nearIndex) };
+			float tFar{ intersectNode(farIndex) };
+
+			if (tNear > tFar)
+			{
+				std::swap(nearIndex, farIndex);
+				std::swap(tNear, tFar);
+			}
+
+			assert(stackSize + 2 <= MAX_DEPTH && "BVH deeper than the traversal stack");
+			if (tFar != FLT_MAX)
+				stack[stackSize++] = farIndex;
+			if (tNear != FLT_MAX)
+				stack[stackSize++] = nearIndex;
+		}
+	}
+#pragma endregion
+}
@@ -0,0 +1,47 @@
+#include "BVHRebuilder.h"
+
+namespace dae
+{
+	void BVHRebuilder::Build(BVH& bvh, const std::vector<AABB>& primitiveBounds)
+	{
+		if (m_PendingBuild.valid())
+			m_PendingBuild.wait();
+		m_PendingBuild = {};
+
+		bvh.Build(primitiveBounds);
+
+		m_BuildCost = bvh.GetCost();
+		m_Cost = m_BuildCost;
+	}
+
+	bool BVHRebuilder::Refit(BVH& bvh, const std::vector<AABB>& primitiveBounds)
+	{
+		bool hasNewTopology{ false };
+		if (m_PendingBuild.valid() && m_PendingBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			//Built from bounds a few frames old, the refit below brings it up to date
+			//Growth stays relative to its own build, so a rebuild that was already stale triggers the next one
+			Rebuild rebuild{ m_PendingBuild.get() };
+			bvh = std::move(rebuild.bvh);
+			m_BuildCost = rebuild.buildCost;
+			hasNewTopology = true;
+		}
+
+		bvh.Refit(primitiveBounds);
+		m_Cost = bvh.GetCost();
+
+		if (!m_PendingBuild.valid() && GetCostGrowth() > m_RebuildThreshold)
+		{
+			//The task gets its own copy of the bounds, the caller is free to change them next frame
+			m_PendingBuild = std::async(std::launch::async, [primitiveBounds, batchSize = bvh.GetLeafBatchSize()]
+				{
+					Rebuild rebuild{};
+					rebuild.bvh.SetLeafBatchSize(batchSize);
+					rebuild.bvh.Build(primitiveBounds);
+					rebuild.buildCost = rebuild.bvh.GetCost();
+					return rebuild;
+				});
+		}
+		return hasNewTopology;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <future>
+#include <vector>
+
+#include "BVH.h"
+
+namespace dae
+{
+	//Keeps a BVH over moving primitives in shape
+	//Every Refit updates the bounds bottom-up in O(n). Once the SAH cost has grown past the threshold
+	//relative to the last build, a full rebuild starts on a background thread while the refit BVH stays in use.
+	//A later Refit swaps the rebuilt BVH in, refit to the bounds of that frame.
+	class BVHRebuilder final
+	{
+	public:
+		BVHRebuilder() = default;
+		~BVHRebuilder() = default;
+
+		BVHRebuilder(const BVHRebuilder&) = delete;
+		BVHRebuilder(BVHRebuilder&&) noexcept = delete;
+		BVHRebuilder& operator=(const BVHRebuilder&) = delete;
+		BVHRebuilder& operator=(BVHRebuilder&&) noexcept = delete;
+
+		//Full build on the calling thread, use when primitives were added or removed
+		//Waits for and drops a background rebuild that was still running
+		void Build(BVH& bvh, const std::vector<AABB>& primitiveBounds);
+
+		//Refits bvh to the new bounds, or swaps in a finished background rebuild first
+		//Returns true if the primitive order (GetPrimitiveIndices) changed
+		bool Refit(BVH& bvh, const std::vector<AABB>& primitiveBounds);
+
+		//Cost after the last refit relative to the cost after the last build, 1 is as good as new
+		float GetCostGrowth() const { return m_BuildCost > 0.f ? m_Cost / m_BuildCost : 1.f; }
+		bool IsRebuilding() const { return m_PendingBuild.valid(); }
+
+		void SetRebuildThreshold(float costGrowth) { m_RebuildThreshold = costGrowth; }
+
+	private:
+		struct Rebuild
+		{
+			BVH bvh{};
+			float buildCost{};
+		};
+		std::future<Rebuild> m_PendingBuild{};
+
+		float m_BuildCost{};
+		float m_Cost{};
+		float m_RebuildThreshold{ 1.5f };
+	};
+}
@@ -0,0 +1,210 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		//Scene names and options are plain identifiers, but quotes and backslashes would still break the JSON
+		std::string EscapeJson(const std::string& text)
+		{
+			std::string escaped{};
+			for (const char character : text)
+			{
+				if (character == '"' || character == '\\')
+					escaped += '\\';
+				escaped += character;
+			}
+			return escaped;
+		}
+	}
+
+#pragma region FrameStats
+	FrameStats::FrameStats(int warmupFrames) :
+		m_WarmupFrames(std::max(warmupFrames, 0))
+	{
+	}
+
+	void FrameStats::AddFrame(double frameTime, uint64_t numRays, const RayCounters& rayCounters)
+	{
+		if (IsWarmingUp())
+		{
+			++m_SkippedFrames;
+			return;
+		}
+
+		m_FrameTimes.push_back(frameTime);
+		m_RayCounts.push_back(numRays);
+		m_RayCounters.push_back(rayCounters);
+	}
+
+	double FrameStats::GetPercentile(double percentile) const
+	{
+		if (m_FrameTimes.empty())
+			return 0.0;
+
+		std::vector<double> sortedTimes{ m_FrameTimes };
+		std::sort(sortedTimes.begin(), sortedTimes.end());
+
+		const size_t rank{ static_cast<size_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * sortedTimes.size())) };
+		return sortedTimes[std::max(rank, size_t(1)) - 1];
+	}
+
+	double FrameStats::GetAverage() const
+	{
+		if (m_FrameTimes.empty())
+			return 0.0;
+		return std::accumulate(m_FrameTimes.begin(), m_FrameTimes.end(), 0.0) / m_FrameTimes.size();
+	}
+
+	double FrameStats::GetMin() const
+	{
+		return m_FrameTimes.empty() ? 0.0 : *std::min_element(m_FrameTimes.begin(), m_FrameTimes.end());
+	}
+
+	double FrameStats::GetMax() const
+	{
+		return m_FrameTimes.empty() ? 0.0 : *std::max_element(m_FrameTimes.begin(), m_FrameTimes.end());
+	}
+
+	double FrameStats::GetRaysPerSecond() const
+	{
+		const double totalTime{ std::accumulate(m_FrameTimes.begin(), m_FrameTimes.end(), 0.0) };
+		if (totalTime <= 0.0)
+			return 0.0;
+		return std::accumulate(m_RayCounts.begin(), m_RayCounts.end(), 0.0) / (totalTime / 1000.0);
+	}
+
+	double FrameStats::GetAverage(RayCounter counter) const
+	{
+		if (m_RayCounters.empty())
+			return 0.0;
+
+		double total{};
+		for (const RayCounters& rayCounters : m_RayCounters)
+			total += static_cast<double>(rayCounters.Get(counter));
+		return total / m_RayCounters.size();
+	}
+#pragma endregion
+
+#pragma region BenchmarkReport
+	void BenchmarkReport::Print(std::ostream& stream) const
+	{
+		for (const Run& run : m_Runs)
+		{
+			const FrameStats& stats{ run.stats };
+			stream << run.sceneName << " (" << run.width << "x" << run.height << ", " << run.numThreads << " thread(s), packet " << run.packetSize
+				<< (run.options.empty() ? "" : ", ") << run.options << ", " << stats.GetFrameCount() << " frames)\n"
+				<< "  avg " << stats.GetAverage() << " ms"
+				<< ", p50 " << stats.GetPercentile(50) << " ms"
+				<< ", p95 " << stats.GetPercentile(95) << " ms"
+				<< ", p99 " << stats.GetPercentile(99) << " ms"
+				<< ", max " << stats.GetMax() << " ms"
+				<< ", " << stats.GetRaysPerSecond() / 1e6 << " Mrays/s" << std::endl;
+
+			if constexpr (RayStats::IS_ENABLED)
+			{
+				stream << "  per frame:";
+				for (int counter{}; counter < static_cast<int>(RayCounter::Count); ++counter)
+				{
+					stream << (counter == 0 ? " " : ", ") << RayCounters::GetName(RayCounter(counter)) << " " << stats.GetAverage(RayCounter(counter));
+				}
+
+				//Traversal cost per traced ray, the number the acceleration structures have to keep down
+				const double numRays{ stats.GetAverage(RayCounter::PrimaryRays) + stats.GetAverage(RayCounter::ShadowRays) };
+				if (numRays > 0.0)
+				{
+					stream << "\n  per ray: nodeVisits " << stats.GetAverage(RayCounter::NodeVisits) / numRays
+						<< ", primitive tests " << (stats.GetAverage(RayCounter::SphereTests) + stats.GetAverage(RayCounter::PlaneTests)
+							+ stats.GetAverage(RayCounter::TriangleTests)) / numRays;
+				}
+				stream << std::endl;
+			}
+		}
+	}
+
+	bool BenchmarkReport::WriteJson(const std::string& filePath) const
+	{
+		std::ofstream file{ filePath };
+		if (!file)
+			return false;
+
+		file << "{\n\t\"runs\": [";
+		for (size_t runIndex{}; runIndex < m_Runs.size(); ++runIndex)
+		{
+			const Run& run{ m_Runs[runIndex] };
+			const FrameStats& stats{ run.stats };
+			file << (runIndex == 0 ? "\n" : ",\n")
+				<< "\t\t{\n"
+				<< "\t\t\t\"scene\": \"" << EscapeJson(run.sceneName) << "\",\n"
+				<< "\t\t\t\"width\": " << run.width << ",\n"
+				<< "\t\t\t\"height\": " << run.height << ",\n"
+				<< "\t\t\t\"threads\": " << run.numThreads << ",\n"
+				<< "\t\t\t\"packetSize\": " << run.packetSize << ",\n"
+				<< "\t\t\t\"options\": \"" << EscapeJson(run.options) << "\",\n"
+				<< "\t\t\t\"frames\": " << stats.GetFrameCount() << ",\n"
+				<< "\t\t\t\"avgMs\": " << stats.GetAverage() << ",\n"
+				<< "\t\t\t\"minMs\": " << stats.GetMin() << ",\n"
+				<< "\t\t\t\"p50Ms\": " << stats.GetPercentile(50) << ",\n"
+				<< "\t\t\t\"p95Ms\": " << stats.GetPercentile(95) << ",\n"
+				<< "\t\t\t\"p99Ms\": " << stats.GetPercentile(99) << ",\n"
+				<< "\t\t\t\"maxMs\": " << stats.GetMax() << ",\n"
+				<< "\t\t\t\"raysPerSecond\": " << stats.GetRaysPerSecond();
+
+			if constexpr (RayStats::IS_ENABLED)
+			{
+				//Averages per frame
+				file << ",\n\t\t\t\"rayCounters\": {";
+				for (int counter{}; counter < static_cast<int>(RayCounter::Count); ++counter)
+				{
+					file << (counter == 0 ? " \"" : ", \"") << RayCounters::GetName(RayCounter(counter)) << "\": " << stats.GetAverage(RayCounter(counter));
+				}
+				file << " }";
+			}
+			file << "\n\t\t}";
+		}
+		file << "\n\t]\n}\n";
+
+		return static_cast<bool>(file);
+	}
+
+	bool BenchmarkReport::WriteCsv(const std::string& filePath) const
+	{
+		std::ofstream file{ filePath };
+		if (!file)
+			return false;
+
+		file << "scene,width,height,threads,packetSize,options,frame,frameMs,rays";
+		if constexpr (RayStats::IS_ENABLED)
+		{
+			for (int counter{}; counter < static_cast<int>(RayCounter::Count); ++counter)
+				file << ',' << RayCounters::GetName(RayCounter(counter));
+		}
+		file << '\n';
+
+		for (const Run& run : m_Runs)
+		{
+			const auto& frameTimes = run.stats.GetFrameTimes();
+			const auto& rayCounts = run.stats.GetRayCounts();
+			const auto& rayCounters = run.stats.GetRayCounters();
+			for (size_t frame{}; frame < frameTimes.size(); ++frame)
+			{
+				file << run.sceneName << ',' << run.width << ',' << run.height << ',' << run.numThreads << ',' << run.packetSize << ','
+					<< run.options << ',' << frame << ',' << frameTimes[frame] << ',' << rayCounts[frame];
+				if constexpr (RayStats::IS_ENABLED)
+				{
+					for (const uint64_t value : rayCounters[frame].values)
+						file << ',' << value;
+				}
+				file << '\n';
+			}
+		}
+
+		return static_cast<bool>(file);
+	}
+#pragma endregion
+}
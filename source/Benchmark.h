@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "RayStats.h"
+
+namespace dae
+{
+	//Per-frame times and ray counts of one benchmark run
+	//The first warmupFrames frames are dropped, they pay for BVH builds and cold caches
+	//Ray counters are only reported when built with DAE_RAY_STATS
+	class FrameStats final
+	{
+	public:
+		explicit FrameStats(int warmupFrames = 0);
+
+		void AddFrame(double frameTime, uint64_t numRays, const RayCounters& rayCounters = {});
+
+		bool IsWarmingUp() const { return m_SkippedFrames < m_WarmupFrames; }
+		size_t GetFrameCount() const { return m_FrameTimes.size(); }
+		const std::vector<double>& GetFrameTimes() const { return m_FrameTimes; }
+		const std::vector<uint64_t>& GetRayCounts() const { return m_RayCounts; }
+		const std::vector<RayCounters>& GetRayCounters() const { return m_RayCounters; }
+
+		//All in ms, percentile in [0, 100] (nearest rank)
+		double GetPercentile(double percentile) const;
+		double GetAverage() const;
+		double GetMin() const;
+		double GetMax() const;
+		double GetRaysPerSecond() const;
+		//Per frame
+		double GetAverage(RayCounter counter) const;
+
+	private:
+		int m_WarmupFrames{};
+		int m_SkippedFrames{};
+		std::vector<double> m_FrameTimes{};
+		std::vector<uint64_t> m_RayCounts{};
+		std::vector<RayCounters> m_RayCounters{};
+	};
+
+	//Benchmark runs with the settings they ran with, as a table, JSON (summaries) or CSV (every frame)
+	class BenchmarkReport final
+	{
+	public:
+		struct Run
+		{
+			std::string sceneName{};
+			int width{};
+			int height{};
+			uint32_t numThreads{};
+			int packetSize{};
+			//Renderer modes that were on, e.g. "aa progressive"
+			std::string options{};
+			FrameStats stats{};
+		};
+
+		void AddRun(const Run& run) { m_Runs.push_back(run); }
+		const std::vector<Run>& GetRuns() const { return m_Runs; }
+
+		void Print(std::ostream& stream) const;
+		//Return true on success
+		bool WriteJson(const std::string& filePath) const;
+		bool WriteCsv(const std::string& filePath) const;
+
+	private:
+		std::vector<Run> m_Runs{};
+	};
+}
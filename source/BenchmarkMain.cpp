@@ -0,0 +1,501 @@
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "Benchmark.h"
+#include "ColorQuantizer.h"
+#include "Matrix.h"
+#include "MeshCache.h"
+#include "OBJLoader.h"
+#include "Profiler.h"
+#include "Timer.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+
+using namespace dae;
+
+//Times the tone map + pack stage on its own, for every instruction set the CPU supports
+void RunQuantizeBenchmark(int width, int height, int numFrames)
+{
+	//Radiance up to 2 so about half the pixels need max-normalizing, like a lit scene
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ 0.f, 2.f };
+	std::vector<ColorRGB> colors(size_t(width) * height);
+	for (ColorRGB& color : colors)
+		color = { distribution(random), distribution(random), distribution(random) };
+
+	std::vector<uint32_t> pixels(colors.size());
+	std::vector<uint32_t> scalarPixels(colors.size());
+	double scalarTime{};
+
+	for (const SIMD::InstructionSet instructionSet : { SIMD::InstructionSet::Scalar, SIMD::InstructionSet::AVX2, SIMD::InstructionSet::AVX512 })
+	{
+		if (instructionSet > SIMD::GetInstructionSet())
+			break;
+
+		ColorQuantizer quantizer{ PixelFormat::ARGB8888 };
+		quantizer.SetInstructionSet(instructionSet);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			for (int py = 0; py < height; ++py)
+				quantizer.QuantizeRow(colors.data() + size_t(py) * width, pixels.data() + size_t(py) * width, width);
+		}
+		const double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numFrames;
+
+		if (instructionSet == SIMD::InstructionSet::Scalar)
+		{
+			scalarTime = frameTime;
+			scalarPixels = pixels;
+		}
+
+		std::cout << "Quantize " << SIMD::GetInstructionSetName(instructionSet) << ": " << frameTime << " ms/frame"
+			<< ", " << scalarTime / frameTime << "x scalar"
+			<< (pixels == scalarPixels ? "" : ", OUTPUT DIFFERS FROM SCALAR") << std::endl;
+	}
+}
+
+//Times what a tile walk does per pixel apart from tracing: the camera ray direction and the frame buffer write
+//The reference is the walk the renderer used before: column by column inside a tile, direction math per pixel.
+//The other one goes row by row and reads the per-column/per-row direction tables like Renderer::RenderTile.
+void RunTraversalBenchmark(int width, int height, int numFrames)
+{
+	constexpr int tileSize = 32; //Renderer::TILE_SIZE
+	const float fov = tanf(45.f * TO_RADIANS / 2.f);
+	const float aspectRatio = float(width) / height;
+	const Matrix cameraToWorld = Matrix::CreateRotation(0.1f, 0.2f, 0.f);
+
+	//Built once, the renderer only rebuilds them when the resolution or FOV changes
+	std::vector<float> columnDirections(width);
+	for (int px = 0; px < width; ++px)
+		columnDirections[px] = (2 * (px + 0.5f) / width - 1) * aspectRatio * fov;
+	std::vector<float> rowDirections(height);
+	for (int py = 0; py < height; ++py)
+		rowDirections[py] = (1 - 2 * (py + 0.5f) / height) * fov;
+
+	const int numTilesX = (width + tileSize - 1) / tileSize;
+	const int numTiles = numTilesX * ((height + tileSize - 1) / tileSize);
+	const auto timeFrames = [=](const auto& walkTile)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < numFrames; ++frame)
+			{
+				for (int tileIndex = 0; tileIndex < numTiles; ++tileIndex)
+				{
+					const int startX = (tileIndex % numTilesX) * tileSize;
+					const int startY = (tileIndex / numTilesX) * tileSize;
+					walkTile(startX, startY, std::min(startX + tileSize, width), std::min(startY + tileSize, height));
+				}
+			}
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numFrames;
+		};
+
+	std::vector<ColorRGB> referencePixels(size_t(width) * height);
+	const double referenceTime = timeFrames([&](int startX, int startY, int endX, int endY)
+		{
+			for (int px = startX; px < endX; ++px)
+			{
+				for (int py = startY; py < endY; ++py)
+				{
+					const float x = (2 * (px + 0.5f) / width - 1) * aspectRatio * fov;
+					const float y = (1 - 2 * (py + 0.5f) / height) * fov;
+					const Vector3 direction = cameraToWorld.TransformVector(x, y, 1.f).Normalized();
+					referencePixels[size_t(py) * width + px] = { direction.x, direction.y, direction.z };
+				}
+			}
+		});
+
+	std::vector<ColorRGB> pixels(referencePixels.size());
+	const double time = timeFrames([&](int startX, int startY, int endX, int endY)
+		{
+			for (int py = startY; py < endY; ++py)
+			{
+				const float y = rowDirections[py];
+				ColorRGB* pRowPixels = pixels.data() + size_t(py) * width;
+				for (int px = startX; px < endX; ++px)
+				{
+					const Vector3 direction = cameraToWorld.TransformVector(columnDirections[px], y, 1.f).Normalized();
+					pRowPixels[px] = { direction.x, direction.y, direction.z };
+				}
+			}
+		});
+
+	const bool isIdentical = std::equal(pixels.begin(), pixels.end(), referencePixels.begin(),
+		[](const ColorRGB& c1, const ColorRGB& c2) { return c1.r == c2.r && c1.g == c2.g && c1.b == c2.b; });
+	std::cout << "Tile walk " << width << "x" << height << ": column-major per pixel math " << referenceTime << " ms/frame"
+		<< ", row-major direction tables " << time << " ms/frame, " << referenceTime / time << "x"
+		<< (isIdentical ? "" : ", OUTPUT DIFFERS FROM REFERENCE") << std::endl;
+}
+
+//The scalar implementations the SIMD math replaced, to compare against
+Matrix ReferenceMultiply(const Matrix& a, const Matrix& b)
+{
+	const Matrix bTransposed = Matrix::Transpose(b);
+	Matrix result{};
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+			result[r][c] = a[r].x * bTransposed[c].x + a[r].y * bTransposed[c].y + a[r].z * bTransposed[c].z + a[r].w * bTransposed[c].w;
+	}
+	return result;
+}
+
+Vector3 ReferenceTransformPoint(const Matrix& m, const Vector3& p)
+{
+	return {
+		m[0].x * p.x + m[1].x * p.y + m[2].x * p.z + m[3].x,
+		m[0].y * p.x + m[1].y * p.y + m[2].y * p.z + m[3].y,
+		m[0].z * p.x + m[1].z * p.y + m[2].z * p.z + m[3].z
+	};
+}
+
+bool AreIdentical(const std::vector<Vector3>& a, const std::vector<Vector3>& b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), [](const Vector3& v1, const Vector3& v2) { return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z; });
+}
+
+//Times matrix multiplies and point transforms against the scalar reference, for every instruction set the CPU supports
+void RunMathBenchmark(int numRounds)
+{
+	constexpr int numMatrices = 4096;
+	constexpr int numPoints = 1 << 14; //stays in cache, so the kernels are timed rather than the memory
+
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ -10.f, 10.f };
+	std::vector<Matrix> matrices(numMatrices);
+	for (Matrix& matrix : matrices)
+	{
+		matrix = Matrix::CreateRotation(distribution(random), distribution(random), distribution(random))
+			* Matrix::CreateTranslation(distribution(random), distribution(random), distribution(random));
+	}
+	std::vector<Vector3> points(numPoints);
+	for (Vector3& point : points)
+		point = { distribution(random), distribution(random), distribution(random) };
+
+	const auto timeRounds = [numRounds](const auto& function)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (int round = 0; round < numRounds; ++round)
+				function();
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numRounds;
+		};
+
+	//Matrix * Matrix
+	std::vector<Matrix> referenceProducts(numMatrices);
+	std::vector<Matrix> products(numMatrices);
+	const double referenceMultiplyTime = timeRounds([&]()
+		{
+			for (int index = 0; index < numMatrices; ++index)
+				referenceProducts[index] = ReferenceMultiply(matrices[index], matrices[(index + 1) % numMatrices]);
+		});
+	const double multiplyTime = timeRounds([&]()
+		{
+			for (int index = 0; index < numMatrices; ++index)
+				products[index] = matrices[index] * matrices[(index + 1) % numMatrices];
+		});
+	std::cout << "Matrix multiply x" << numMatrices << ": reference " << referenceMultiplyTime << " ms, SIMD " << multiplyTime << " ms"
+		<< ", " << referenceMultiplyTime / multiplyTime << "x"
+		<< (products == referenceProducts ? "" : ", OUTPUT DIFFERS FROM REFERENCE") << std::endl;
+
+	//Points, one by one and batched
+	const Matrix& transform = matrices[0];
+	std::vector<Vector3> referencePoints(numPoints);
+	std::vector<Vector3> transformedPoints(numPoints);
+	const double referenceTransformTime = timeRounds([&]()
+		{
+			for (int index = 0; index < numPoints; ++index)
+				referencePoints[index] = ReferenceTransformPoint(transform, points[index]);
+		});
+	std::cout << "TransformPoint x" << numPoints << ": reference " << referenceTransformTime << " ms" << std::endl;
+
+	const double transformTime = timeRounds([&]()
+		{
+			for (int index = 0; index < numPoints; ++index)
+				transformedPoints[index] = transform.TransformPoint(points[index]);
+		});
+	std::cout << "  single: " << transformTime << " ms, " << referenceTransformTime / transformTime << "x"
+		<< (AreIdentical(transformedPoints, referencePoints) ? "" : ", OUTPUT DIFFERS FROM REFERENCE") << std::endl;
+
+	for (const SIMD::InstructionSet instructionSet : { SIMD::InstructionSet::Scalar, SIMD::InstructionSet::AVX2 })
+	{
+		if (instructionSet > SIMD::GetInstructionSet())
+			break;
+
+		const double batchTime = timeRounds([&]()
+			{
+				transform.TransformPoints(points.data(), transformedPoints.data(), points.size(), instructionSet);
+			});
+		std::cout << "  batch " << SIMD::GetInstructionSetName(instructionSet) << ": " << batchTime << " ms, " << referenceTransformTime / batchTime << "x"
+			<< (AreIdentical(transformedPoints, referencePoints) ? "" : ", OUTPUT DIFFERS FROM REFERENCE") << std::endl;
+	}
+}
+
+//Writes a gridSize x gridSize grid of quads with v/vt/vn corners and relative indices, for benchmarking without an asset
+bool WriteOBJGrid(const std::string& filePath, int gridSize)
+{
+	std::ofstream file{ filePath };
+	if (!file)
+		return false;
+
+	file << "# " << gridSize << "x" << gridSize << " quad grid\nvn 0 1 0\n";
+	for (int row = 0; row <= gridSize; ++row)
+	{
+		for (int column = 0; column <= gridSize; ++column)
+		{
+			const float u = static_cast<float>(column) / gridSize;
+			const float v = static_cast<float>(row) / gridSize;
+			file << "v " << u * 100.f - 50.f << " " << std::sin(u * 20.f) * std::cos(v * 20.f) << " " << v * 100.f - 50.f << "\n"
+				<< "vt " << u << " " << v << "\n";
+		}
+
+		//The previous row's quads, counted back from the vertices written so far
+		if (row == 0)
+			continue;
+		const int rowSize = gridSize + 1;
+		for (int column = 0; column < gridSize; ++column)
+		{
+			const int v0 = -(2 * rowSize - column), v1 = v0 + 1, v2 = -(rowSize - column) + 1, v3 = v2 - 1;
+			file << "f " << v0 << "/" << v0 << "/1 " << v1 << "/" << v1 << "/1 " << v2 << "/" << v2 << "/1 " << v3 << "/" << v3 << "/1\n";
+		}
+	}
+
+	return static_cast<bool>(file);
+}
+
+//Times OBJLoader::Load on one file, single threaded and with a pool, then MeshCache::LoadOBJ without and with its cache
+void RunOBJBenchmark(const std::string& filePath, int numFrames, uint32_t numThreads)
+{
+	std::ifstream file{ filePath, std::ios::binary | std::ios::ate };
+	const double fileSize = file ? static_cast<double>(file.tellg()) : 0.0;
+	file.close();
+
+	ThreadPool threadPool{ numThreads };
+	for (ThreadPool* pThreadPool : { static_cast<ThreadPool*>(nullptr), &threadPool })
+	{
+		OBJMesh mesh{};
+		double totalTime{};
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (!OBJLoader::Load(filePath, mesh, pThreadPool))
+			{
+				std::cout << "Can't load " << filePath << std::endl;
+				return;
+			}
+			totalTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		const double loadTime = totalTime / numFrames;
+		std::cout << "OBJ " << filePath << " (" << fileSize / (1 << 20) << " MB, " << mesh.GetTriangleCount() << " triangles, " << mesh.positions.size() << " vertices)"
+			<< ", " << (pThreadPool ? pThreadPool->GetThreadCount() : 1) << " thread(s): " << loadTime << " ms, "
+			<< fileSize / (1 << 20) / (loadTime / 1000.0) << " MB/s" << std::endl;
+	}
+
+	//Scene startup: parse + BVH build + cache write the first time, cache read every time after
+	std::remove(MeshCache::GetCachePath(filePath).c_str());
+	for (const char* pName : { "cold (parse, BVH, write cache)", "warm (read cache)" })
+	{
+		TriangleMesh mesh{};
+		const auto start = std::chrono::steady_clock::now();
+		if (!MeshCache::LoadOBJ(filePath, mesh, &threadPool))
+		{
+			std::cout << "Can't load " << filePath << std::endl;
+			return;
+		}
+		std::cout << "Mesh " << pName << ": " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms, "
+			<< mesh.indices.size() / 3 << " triangles, " << mesh.bvh.GetNodes().size() << " BVH nodes" << std::endl;
+	}
+}
+
+//Renders every test scene (or the one given with --scene) headless, prints frame time percentiles
+//and optionally writes them as JSON (--json) and every frame as CSV (--csv) for comparing builds
+//--trace writes the profiler zones of the last frames as a Chrome trace
+//--quantize times the frame buffer conversion instead, --math the vector/matrix kernels, --traversal the tile walk
+//--obj times loading an OBJ file (and through the mesh cache), --obj-grid N writes an N x N quad grid there first
+int main(int argc, char* args[])
+{
+	//Command line
+	uint32_t numThreads = 0; //0 = one thread per hardware core
+	int packetSize = 4; //1 = no packets
+	int numWarmupFrames = 3; //not recorded, the first one builds the acceleration structures
+	int numFrames = 30;
+	int width = 640;
+	int height = 480;
+	bool isProgressive = false; //accumulate samples, frames get cheaper as pixels converge
+	bool isAntiAliased = false; //extra samples on edges only
+	bool isWavefront = false; //stage by stage over the whole frame instead of pixel by pixel
+	float targetFrameTime = 0.f; //ms, dynamic resolution when above 0
+	bool isQuantizeBenchmark = false; //only time the frame buffer conversion
+	bool isMathBenchmark = false; //only time the vector/matrix kernels
+	bool isTraversalBenchmark = false; //only time the tile walk without tracing
+	std::string objPath{}; //only time loading this OBJ file
+	int objGridSize = 0; //write a synthetic grid to objPath first
+	std::string jsonPath{};
+	std::string csvPath{};
+	std::string tracePath{}; //Chrome trace of the last frames (needs RAYTRACER_PROFILING)
+	std::vector<std::string> sceneNames = Scene::GetSceneNames();
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		const std::string arg = args[argIndex];
+		if ((arg == "-t" || arg == "--threads") && argIndex + 1 < argc)
+			numThreads = static_cast<uint32_t>(std::stoul(args[++argIndex]));
+		else if ((arg == "-p" || arg == "--packet") && argIndex + 1 < argc)
+			packetSize = std::stoi(args[++argIndex]);
+		else if ((arg == "-s" || arg == "--scene") && argIndex + 1 < argc)
+			sceneNames = { args[++argIndex] };
+		else if ((arg == "-f" || arg == "--frames") && argIndex + 1 < argc)
+			numFrames = std::max(std::stoi(args[++argIndex]), 1);
+		else if ((arg == "-w" || arg == "--warmup") && argIndex + 1 < argc)
+			numWarmupFrames = std::max(std::stoi(args[++argIndex]), 0);
+		else if (arg == "--width" && argIndex + 1 < argc)
+			width = std::stoi(args[++argIndex]);
+		else if (arg == "--height" && argIndex + 1 < argc)
+			height = std::stoi(args[++argIndex]);
+		else if (arg == "--progressive")
+			isProgressive = true;
+		else if (arg == "--aa")
+			isAntiAliased = true;
+		else if (arg == "--wavefront")
+			isWavefront = true;
+		else if (arg == "--target-ms" && argIndex + 1 < argc)
+			targetFrameTime = std::stof(args[++argIndex]);
+		else if (arg == "-q" || arg == "--quantize")
+			isQuantizeBenchmark = true;
+		else if (arg == "--math")
+			isMathBenchmark = true;
+		else if (arg == "--traversal")
+			isTraversalBenchmark = true;
+		else if (arg == "--obj" && argIndex + 1 < argc)
+			objPath = args[++argIndex];
+		else if (arg == "--obj-grid" && argIndex + 1 < argc)
+			objGridSize = std::max(std::stoi(args[++argIndex]), 1);
+		else if (arg == "--json" && argIndex + 1 < argc)
+			jsonPath = args[++argIndex];
+		else if (arg == "--csv" && argIndex + 1 < argc)
+			csvPath = args[++argIndex];
+		else if (arg == "--trace" && argIndex + 1 < argc)
+			tracePath = args[++argIndex];
+	}
+
+	if (isQuantizeBenchmark)
+	{
+		RunQuantizeBenchmark(width, height, numFrames);
+		return 0;
+	}
+
+	if (isMathBenchmark)
+	{
+		RunMathBenchmark(numFrames);
+		return 0;
+	}
+
+	if (isTraversalBenchmark)
+	{
+		RunTraversalBenchmark(width, height, numFrames);
+		return 0;
+	}
+
+	if (!objPath.empty())
+	{
+		if (objGridSize > 0 && !WriteOBJGrid(objPath, objGridSize))
+		{
+			std::cout << "Can't write " << objPath << std::endl;
+			return 1;
+		}
+		RunOBJBenchmark(objPath, numFrames, numThreads);
+		return 0;
+	}
+
+	std::ostringstream optionStream{};
+	if (isProgressive)
+		optionStream << "progressive ";
+	if (isAntiAliased)
+		optionStream << "aa ";
+	if (isWavefront)
+		optionStream << "wavefront ";
+	if (targetFrameTime > 0.f)
+		optionStream << "target-ms=" << targetFrameTime << " ";
+	std::string options = optionStream.str();
+	if (!options.empty())
+		options.pop_back();
+
+	BenchmarkReport report{};
+	for (const std::string& sceneName : sceneNames)
+	{
+		Scene* pScene = Scene::CreateByName(sceneName);
+		if (!pScene)
+		{
+			std::cout << "Unknown scene " << sceneName << std::endl;
+			return 1;
+		}
+		pScene->Initialize();
+
+		//A fresh renderer per scene, so dynamic resolution and accumulation don't carry over
+		Renderer renderer{ width, height };
+		renderer.SetThreadCount(numThreads);
+		renderer.SetPacketSize(packetSize);
+		renderer.SetProgressive(isProgressive);
+		renderer.SetAdaptiveAntiAliasing(isAntiAliased);
+		renderer.SetWavefront(isWavefront);
+		renderer.SetTargetFrameTime(targetFrameTime);
+
+		Timer timer{};
+		timer.Start();
+
+		//A frame is the scene update (BVH refits included) plus the render
+		FrameStats stats{ numWarmupFrames };
+		for (int frame = 0; frame < numWarmupFrames + numFrames; ++frame)
+		{
+			DAE_PROFILE_ZONE("Frame");
+			const auto frameStart = std::chrono::steady_clock::now();
+
+			timer.Update();
+			pScene->Update(&timer);
+			renderer.Render(pScene);
+
+			stats.AddFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count(), renderer.GetPrimaryRayCount(), renderer.GetRayCounters());
+		}
+
+		report.AddRun({ sceneName, width, height, renderer.GetThreadCount(), renderer.GetPacketSize(), options, stats });
+		delete pScene;
+	}
+
+	report.Print(std::cout);
+
+	if (!jsonPath.empty() && !report.WriteJson(jsonPath))
+	{
+		std::cout << "Something went wrong. " << jsonPath << " not saved!" << std::endl;
+		return 1;
+	}
+	if (!csvPath.empty() && !report.WriteCsv(csvPath))
+	{
+		std::cout << "Something went wrong. " << csvPath << " not saved!" << std::endl;
+		return 1;
+	}
+	if (!tracePath.empty())
+	{
+		if (!Profiler::IS_ENABLED)
+		{
+			std::cout << "Built without RAYTRACER_PROFILING, " << tracePath << " not saved!" << std::endl;
+			return 1;
+		}
+		if (!Profiler::WriteChromeTrace(tracePath))
+		{
+			std::cout << "Something went wrong. " << tracePath << " not saved!" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
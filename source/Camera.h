@@ -1,13 +1,26 @@
 #pragma once
 #include <cassert>
-#include <SDL_keyboard.h>
-#include <SDL_mouse.h>
+#include <cstdint>
 
 #include "Math.h"
 #include "Timer.h"
 
 namespace dae
 {
+	//Input state for one frame, filled in by the front-end (main.cpp reads it from SDL)
+	struct CameraInput
+	{
+		bool moveForward{};
+		bool moveBackward{};
+		bool moveLeft{};
+		bool moveRight{};
+
+		int mouseX{};
+		int mouseY{};
+		bool isLeftMouseDown{};
+		bool isRightMouseDown{};
+	};
+
 	struct Camera
 	{
 		Camera() = default;
@@ -31,25 +44,23 @@ namespace dae
 
 		Matrix cameraToWorld{};
 
+		CameraInput input{};
+
 
 		Matrix CalculateCameraToWorld()
 		{
-			//todo: W2
-			assert(false && "Not Implemented Yet");
-			return {};
+			right = Vector3::Cross(Vector3::UnitY, forward).Normalized();
+			up = Vector3::Cross(forward, right).Normalized();
+
+			cameraToWorld = Matrix{ right, up, forward, origin };
+			return cameraToWorld;
 		}
 
-		void Update(Timer* pTimer)
+		void Update([[maybe_unused]] Timer* pTimer)
 		{
-			const float deltaTime = pTimer->GetElapsed();
-
-			//Keyboard Input
-			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
-
+			//Keyboard Input: input.moveForward/moveBackward/moveLeft/moveRight, scaled by pTimer->GetElapsed()
 
-			//Mouse Input
-			int mouseX{}, mouseY{};
-			const uint32_t mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
+			//Mouse Input: input.mouseX/mouseY, relative to the last frame
 
 			//todo: W2
 			//assert(false && "Not Implemented Yet");
@@ -0,0 +1,204 @@
+#include "ColorQuantizer.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	namespace
+	{
+		static_assert(sizeof(ColorRGB) == 3 * sizeof(float), "The kernels load colors as packed float triplets");
+
+		template<PixelFormat Format>
+		constexpr uint32_t Pack(uint32_t r, uint32_t g, uint32_t b)
+		{
+			if constexpr (Format == PixelFormat::ARGB8888)
+				return 0xFF000000u | r << 16 | g << 8 | b;
+			else
+				return 0xFF000000u | b << 16 | g << 8 | r;
+		}
+
+#pragma region Scalar
+		template<PixelFormat Format>
+		void QuantizeRow_Scalar(const ColorRGB* pColors, uint32_t* pPixels, int count)
+		{
+			for (int index{}; index < count; ++index)
+			{
+				ColorRGB color{ pColors[index] };
+				color.MaxToOne();
+
+				pPixels[index] = Pack<Format>(
+					static_cast<uint8_t>(color.r * 255),
+					static_cast<uint8_t>(color.g * 255),
+					static_cast<uint8_t>(color.b * 255));
+			}
+		}
+#pragma endregion
+
+#if DAE_SIMD_X64
+#pragma region AVX2
+		//8 colors per iteration, the three loads hold rgb rgb rg | b rgb rgb r | gb rgb rgb
+		//Blending them leaves every channel in a fixed lane order that one permute undoes
+		template<PixelFormat Format>
+		DAE_TARGET_AVX2 void QuantizeRow_AVX2(const ColorRGB* pColors, uint32_t* pPixels, int count)
+		{
+			const __m256i redOrder{ _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5) };
+			const __m256i greenOrder{ _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6) };
+			const __m256i blueOrder{ _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7) };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m256 scale{ _mm256_set1_ps(255.f) };
+
+			int index{};
+			for (; index + 8 <= count; index += 8)
+			{
+				const float* pFloats{ &pColors[index].r };
+				const __m256 load0{ _mm256_loadu_ps(pFloats) };
+				const __m256 load1{ _mm256_loadu_ps(pFloats + 8) };
+				const __m256 load2{ _mm256_loadu_ps(pFloats + 16) };
+
+				__m256 r{ _mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x92), load2, 0x24) };
+				__m256 g{ _mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x24), load2, 0x49) };
+				__m256 b{ _mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x49), load2, 0x92) };
+				r = _mm256_permutevar8x32_ps(r, redOrder);
+				g = _mm256_permutevar8x32_ps(g, greenOrder);
+				b = _mm256_permutevar8x32_ps(b, blueOrder);
+
+				//MaxToOne: divide (not multiply by the reciprocal) so the rounding matches
+				const __m256 maxValue{ _mm256_max_ps(r, _mm256_max_ps(g, b)) };
+				const __m256 isOverOne{ _mm256_cmp_ps(maxValue, one, _CMP_GT_OQ) };
+				r = _mm256_blendv_ps(r, _mm256_div_ps(r, maxValue), isOverOne);
+				g = _mm256_blendv_ps(g, _mm256_div_ps(g, maxValue), isOverOne);
+				b = _mm256_blendv_ps(b, _mm256_div_ps(b, maxValue), isOverOne);
+
+				const __m256i r8{ _mm256_cvttps_epi32(_mm256_mul_ps(r, scale)) };
+				const __m256i g8{ _mm256_cvttps_epi32(_mm256_mul_ps(g, scale)) };
+				const __m256i b8{ _mm256_cvttps_epi32(_mm256_mul_ps(b, scale)) };
+
+				const __m256i high{ Format == PixelFormat::ARGB8888 ? r8 : b8 };
+				const __m256i low{ Format == PixelFormat::ARGB8888 ? b8 : r8 };
+				const __m256i pixels{ _mm256_or_si256(_mm256_or_si256(_mm256_set1_epi32(static_cast<int>(0xFF000000u)), _mm256_slli_epi32(high, 16)),
+					_mm256_or_si256(_mm256_slli_epi32(g8, 8), low)) };
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + index), pixels);
+			}
+
+			QuantizeRow_Scalar<Format>(pColors + index, pPixels + index, count - index);
+		}
+#pragma endregion
+
+#pragma region AVX512
+		//Index tables that gather channel c of 16 colors out of three loads: lanes up to float 31 come from the first two, the rest from the third
+		struct ChannelOrder
+		{
+			int32_t fromFirstTwo[16];
+			int32_t withThird[16];
+		};
+
+		constexpr ChannelOrder MakeChannelOrder(int channel)
+		{
+			ChannelOrder order{};
+			for (int lane{}; lane < 16; ++lane)
+			{
+				const int source{ 3 * lane + channel };
+				order.fromFirstTwo[lane] = source < 32 ? source : 0;
+				order.withThird[lane] = source < 32 ? lane : 16 + source - 32;
+			}
+			return order;
+		}
+
+		constexpr ChannelOrder CHANNEL_ORDERS[3]{ MakeChannelOrder(0), MakeChannelOrder(1), MakeChannelOrder(2) };
+
+		DAE_TARGET_AVX512 inline __m512 GatherChannel_AVX512(const ChannelOrder& order, __m512 load0, __m512 load1, __m512 load2)
+		{
+			const __m512 fromFirstTwo{ _mm512_permutex2var_ps(load0, _mm512_loadu_si512(order.fromFirstTwo), load1) };
+			return _mm512_permutex2var_ps(fromFirstTwo, _mm512_loadu_si512(order.withThird), load2);
+		}
+
+		//16 colors per iteration
+		template<PixelFormat Format>
+		DAE_TARGET_AVX512 void QuantizeRow_AVX512(const ColorRGB* pColors, uint32_t* pPixels, int count)
+		{
+			const __m512 one{ _mm512_set1_ps(1.f) };
+			const __m512 scale{ _mm512_set1_ps(255.f) };
+
+			int index{};
+			for (; index + 16 <= count; index += 16)
+			{
+				const float* pFloats{ &pColors[index].r };
+				const __m512 load0{ _mm512_loadu_ps(pFloats) };
+				const __m512 load1{ _mm512_loadu_ps(pFloats + 16) };
+				const __m512 load2{ _mm512_loadu_ps(pFloats + 32) };
+
+				__m512 r{ GatherChannel_AVX512(CHANNEL_ORDERS[0], load0, load1, load2) };
+				__m512 g{ GatherChannel_AVX512(CHANNEL_ORDERS[1], load0, load1, load2) };
+				__m512 b{ GatherChannel_AVX512(CHANNEL_ORDERS[2], load0, load1, load2) };
+
+				const __m512 maxValue{ _mm512_max_ps(r, _mm512_max_ps(g, b)) };
+				const __mmask16 isOverOne{ _mm512_cmp_ps_mask(maxValue, one, _CMP_GT_OQ) };
+				r = _mm512_mask_div_ps(r, isOverOne, r, maxValue);
+				g = _mm512_mask_div_ps(g, isOverOne, g, maxValue);
+				b = _mm512_mask_div_ps(b, isOverOne, b, maxValue);
+
+				const __m512i r8{ _mm512_cvttps_epi32(_mm512_mul_ps(r, scale)) };
+				const __m512i g8{ _mm512_cvttps_epi32(_mm512_mul_ps(g, scale)) };
+				const __m512i b8{ _mm512_cvttps_epi32(_mm512_mul_ps(b, scale)) };
+
+				const __m512i high{ Format == PixelFormat::ARGB8888 ? r8 : b8 };
+				const __m512i low{ Format == PixelFormat::ARGB8888 ? b8 : r8 };
+				const __m512i pixels{ _mm512_or_si512(_mm512_or_si512(_mm512_set1_epi32(static_cast<int>(0xFF000000u)), _mm512_slli_epi32(high, 16)),
+					_mm512_or_si512(_mm512_slli_epi32(g8, 8), low)) };
+				_mm512_storeu_si512(pPixels + index, pixels);
+			}
+
+			QuantizeRow_Scalar<Format>(pColors + index, pPixels + index, count - index);
+		}
+#pragma endregion
+#endif
+
+		template<PixelFormat Format>
+		void (*GetKernel(SIMD::InstructionSet instructionSet))(const ColorRGB*, uint32_t*, int)
+		{
+			switch (instructionSet)
+			{
+#if DAE_SIMD_X64
+			case SIMD::InstructionSet::AVX2:
+				return QuantizeRow_AVX2<Format>;
+			case SIMD::InstructionSet::AVX512:
+				return QuantizeRow_AVX512<Format>;
+#endif
+			default:
+				return QuantizeRow_Scalar<Format>;
+			}
+		}
+	}
+
+	ColorQuantizer::ColorQuantizer(PixelFormat format) :
+		m_Format(format),
+		m_InstructionSet(SIMD::GetInstructionSet())
+	{
+		SelectKernel();
+	}
+
+	void ColorQuantizer::SetFormat(PixelFormat format)
+	{
+		m_Format = format;
+		SelectKernel();
+	}
+
+	void ColorQuantizer::SetInstructionSet(SIMD::InstructionSet instructionSet)
+	{
+		m_InstructionSet = instructionSet;
+		SelectKernel();
+	}
+
+	void ColorQuantizer::SelectKernel()
+	{
+		switch (m_Format)
+		{
+		case PixelFormat::ABGR8888:
+			m_pKernel = GetKernel<PixelFormat::ABGR8888>(m_InstructionSet);
+			break;
+		default:
+			m_pKernel = GetKernel<PixelFormat::ARGB8888>(m_InstructionSet);
+			break;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+#include "ColorRGB.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	//Packed 32 bit layouts the quantizer writes, named like the SDL pixel formats (most significant byte first)
+	//The X formats (SDL_PIXELFORMAT_RGB888/BGR888) use the same kernels, their unused byte gets 0xFF too.
+	enum class PixelFormat
+	{
+		ARGB8888,
+		ABGR8888
+	};
+
+	//Tone maps rows of float colors into packed 8 bit pixels: max-normalize (ColorRGB::MaxToOne), scale to 255 and truncate
+	//The kernel is picked once for the format and instruction set, the vector kernels produce the same bytes as the scalar one.
+	//Colors must not be negative (radiance never is), the 8 bit conversion isn't defined for them.
+	class ColorQuantizer final
+	{
+	public:
+		explicit ColorQuantizer(PixelFormat format = PixelFormat::ARGB8888);
+		~ColorQuantizer() = default;
+
+		void SetFormat(PixelFormat format);
+		PixelFormat GetFormat() const { return m_Format; }
+
+		//Overrides the detected instruction set, e.g. to force the scalar fallback
+		void SetInstructionSet(SIMD::InstructionSet instructionSet);
+		SIMD::InstructionSet GetInstructionSet() const { return m_InstructionSet; }
+
+		void QuantizeRow(const ColorRGB* pColors, uint32_t* pPixels, int count) const { m_pKernel(pColors, pPixels, count); }
+
+	private:
+		using RowKernel = void(*)(const ColorRGB* pColors, uint32_t* pPixels, int count);
+
+		PixelFormat m_Format{};
+		SIMD::InstructionSet m_InstructionSet{ SIMD::InstructionSet::Scalar };
+		RowKernel m_pKernel{};
+
+		void SelectKernel();
+	};
+}
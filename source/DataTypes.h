@@ -1,7 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 
 #include "Math.h"
+#include "BVH.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 #include "vector"
 
 namespace dae
@@ -62,17 +67,16 @@ namespace dae
 		{
 			//Calculate Normals
 			CalculateNormals();
-
-			//Update Transforms
-			UpdateTransforms();
 		}
 
 		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
 			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
 		{
-			UpdateTransforms();
 		}
 
+		//Vertices per UpdateTransforms task, a multiple of the 8 the batch transform does at once
+		static constexpr size_t VERTICES_PER_TASK{ 1 << 14 };
+
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
@@ -80,29 +84,28 @@ namespace dae
 
 		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
 
-		Matrix rotationTransform{};
-		Matrix translationTransform{};
-		Matrix scaleTransform{};
-
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		//Bottom-level BVH over the untransformed triangles (mesh space), primitive i is the triangle starting at indices[3 * i]
+		//Built by the Scene when triangles are added and refit when vertices are edited, moving the mesh or instancing it never touches it
+		BVH bvh{};
 
+		//Setting the transform a mesh already has keeps the baked vertices valid
 		void Translate(const Vector3& translation)
 		{
-			translationTransform = Matrix::CreateTranslation(translation);
+			SetTransform(m_TranslationTransform, Matrix::CreateTranslation(translation));
 		}
 
 		void RotateY(float yaw)
 		{
-			rotationTransform = Matrix::CreateRotationY(yaw);
+			SetTransform(m_RotationTransform, Matrix::CreateRotationY(yaw));
 		}
 
 		void Scale(const Vector3& scale)
 		{
-			scaleTransform = Matrix::CreateScale(scale);
+			SetTransform(m_ScaleTransform, Matrix::CreateScale(scale));
 		}
 
-		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
+		//Only appends, the transformed vertices are baked on the next UpdateTransforms
+		void AppendTriangle(const Triangle& triangle)
 		{
 			int startIndex = static_cast<int>(positions.size());
 
@@ -116,29 +119,165 @@ namespace dae
 
 			normals.push_back(triangle.normal);
 
-			//Not ideal, but making sure all vertices are updated
-			if(!ignoreTransformUpdate)
-				UpdateTransforms();
+			m_AreTransformsDirty = true;
+			m_IsBVHDirty = true;
 		}
 
 		void CalculateNormals()
 		{
-			assert(false && "No Implemented Yet!");
+			//One normal per triangle, following the winding order like the Triangle constructor
+			normals.resize(indices.size() / 3);
+			for (size_t triangleIndex{}; triangleIndex < normals.size(); ++triangleIndex)
+			{
+				const Vector3& v0{ positions[indices[triangleIndex * 3]] };
+				const Vector3& v1{ positions[indices[triangleIndex * 3 + 1]] };
+				const Vector3& v2{ positions[indices[triangleIndex * 3 + 2]] };
+
+				normals[triangleIndex] = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
+			}
+
+			m_AreTransformsDirty = true;
+		}
+
+		//scale * rotation * translation, kept up to date by Translate/RotateY/Scale
+		const Matrix& GetTransform() const
+		{
+			return m_Transform;
+		}
+
+		//Call after editing positions or normals directly, the Append/Calculate functions already do
+		void MarkVerticesDirty()
+		{
+			m_AreTransformsDirty = true;
+			m_IsBVHDirty = true;
+		}
+
+		//Vertices were marked dirty or triangles were added since the BVH was last built, refit or assigned
+		bool IsBVHDirty() const
+		{
+			return m_IsBVHDirty || bvh.GetPrimitiveCount() != indices.size() / 3;
+		}
+
+		//Bakes the transform into the transformed positions/normals, only when the transform or the vertices changed since the last bake
+		//Tracing doesn't need this, rays are moved into mesh space instead
+		//Large meshes are split over the pool's threads when one is given
+		void UpdateTransforms(ThreadPool* pThreadPool = nullptr)
+		{
+			if (!m_AreTransformsDirty)
+				return;
+
+			DAE_PROFILE_ZONE("TriangleMesh::UpdateTransforms");
+			m_TransformedPositions.resize(positions.size());
+			m_TransformedNormals.resize(normals.size());
+
+			const size_t numVertices{ std::max(positions.size(), normals.size()) };
+			const uint32_t numTasks{ static_cast<uint32_t>((numVertices + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK) };
+			if (pThreadPool && numTasks > 1)
+			{
+				pThreadPool->ParallelFor(numTasks, [this](uint32_t taskIndex) { TransformVertices(taskIndex * VERTICES_PER_TASK, VERTICES_PER_TASK); });
+			}
+			else
+			{
+				TransformVertices(0, numVertices);
+			}
+
+			m_AreTransformsDirty = false;
+		}
+
+		const std::vector<Vector3>& GetTransformedPositions()
+		{
+			UpdateTransforms();
+			return m_TransformedPositions;
+		}
+
+		const std::vector<Vector3>& GetTransformedNormals()
+		{
+			UpdateTransforms();
+			return m_TransformedNormals;
+		}
+
+		void UpdateBVH()
+		{
+			bvh.Build(GetTriangleBounds());
+			m_IsBVHDirty = false;
+		}
+
+		//Keeps the tree and only updates its bounds, for vertices edited in place (the triangle count must be the one it was built with)
+		void RefitBVH()
+		{
+			assert(!bvh.IsEmpty() && bvh.GetPrimitiveCount() == indices.size() / 3);
+			bvh.Refit(GetTriangleBounds());
+			m_IsBVHDirty = false;
+		}
+
+		//Takes over a BVH built earlier for exactly these positions and indices, e.g. one read back from the MeshCache
+		void AssignBVH(std::vector<BVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices)
+		{
+			bvh.Assign(std::move(nodes), std::move(primitiveIndices));
+			m_IsBVHDirty = false;
+		}
+
+	private:
+		Matrix m_RotationTransform{};
+		Matrix m_TranslationTransform{};
+		Matrix m_ScaleTransform{};
+		Matrix m_Transform{};
+
+		std::vector<Vector3> m_TransformedPositions{};
+		std::vector<Vector3> m_TransformedNormals{};
+		bool m_AreTransformsDirty{ true };
+		bool m_IsBVHDirty{ true };
+
+		std::vector<AABB> GetTriangleBounds() const
+		{
+			std::vector<AABB> triangleBounds(indices.size() / 3);
+			for (size_t triangleIndex{}; triangleIndex < triangleBounds.size(); ++triangleIndex)
+			{
+				triangleBounds[triangleIndex].Grow(positions[indices[triangleIndex * 3]]);
+				triangleBounds[triangleIndex].Grow(positions[indices[triangleIndex * 3 + 1]]);
+				triangleBounds[triangleIndex].Grow(positions[indices[triangleIndex * 3 + 2]]);
+			}
+			return triangleBounds;
 		}
 
-		void UpdateTransforms()
+		void SetTransform(Matrix& transform, const Matrix& newTransform)
 		{
-			assert(false && "No Implemented Yet!");
-			//Calculate Final Transform 
-			//const auto finalTransform = ...
+			if (transform == newTransform)
+				return;
 
-			//Transform Positions (positions > transformedPositions)
-			//...
+			transform = newTransform;
+			m_Transform = m_ScaleTransform * m_RotationTransform * m_TranslationTransform;
+			m_AreTransformsDirty = true;
+		}
 
-			//Transform Normals (normals > transformedNormals)
-			//...
+		//Vertices [first, first + count) clamped to each array, positions and normals are counted separately
+		void TransformVertices(size_t first, size_t count)
+		{
+			if (first < positions.size())
+			{
+				const size_t numPositions{ std::min(count, positions.size() - first) };
+				m_Transform.TransformPoints(positions.data() + first, m_TransformedPositions.data() + first, numPositions);
+			}
+
+			if (first < normals.size())
+			{
+				const size_t numNormals{ std::min(count, normals.size() - first) };
+				m_Transform.TransformVectors(normals.data() + first, m_TransformedNormals.data() + first, numNormals);
+				for (size_t normalIndex{ first }; normalIndex < first + numNormals; ++normalIndex)
+				{
+					m_TransformedNormals[normalIndex].Normalize();
+				}
+			}
 		}
 	};
+
+	//One placement of a TriangleMesh, many instances share the mesh's vertices and BVH
+	//The final placement is the mesh's own GetTransform() followed by this transform
+	struct MeshInstance
+	{
+		uint32_t meshIndex{};
+		Matrix transform{};
+	};
 #pragma endregion
 #pragma region LIGHT
 	enum class LightType
@@ -176,5 +315,22 @@ namespace dae
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
+
+	//Last primitive that blocked a shadow ray towards one light
+	//Neighbouring shadow rays towards the same light are likely blocked by it too, so it gets tested first.
+	//Keep one per light and per thread.
+	struct OcclusionCache
+	{
+		enum class PrimitiveType : unsigned char
+		{
+			None,
+			Sphere,
+			Plane,
+			MeshInstance
+		};
+
+		PrimitiveType type{ PrimitiveType::None };
+		uint32_t index{};
+	};
 #pragma endregion
 }
\ No newline at end of file
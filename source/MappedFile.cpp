@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	MappedFile::MappedFile(const std::string& filePath)
+	{
+#if defined(_WIN32)
+		const HANDLE file{ CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size{};
+		if (GetFileSizeEx(file, &size))
+		{
+			m_Size = static_cast<size_t>(size.QuadPart);
+			m_IsOpen = true;
+			if (m_Size > 0)
+			{
+				const HANDLE mapping{ CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+				if (mapping)
+				{
+					m_pData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+					CloseHandle(mapping);
+				}
+				m_IsOpen = m_pData != nullptr;
+			}
+		}
+		CloseHandle(file);
+#else
+		const int file{ open(filePath.c_str(), O_RDONLY) };
+		if (file < 0)
+			return;
+
+		struct stat status{};
+		if (fstat(file, &status) == 0)
+		{
+			m_Size = static_cast<size_t>(status.st_size);
+			m_IsOpen = true;
+			if (m_Size > 0)
+			{
+				void* pData{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0) };
+				if (pData != MAP_FAILED)
+				{
+					madvise(pData, m_Size, MADV_SEQUENTIAL);
+					m_pData = static_cast<const char*>(pData);
+				}
+				m_IsOpen = m_pData != nullptr;
+			}
+		}
+		//The mapping stays valid without the descriptor
+		close(file);
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (!m_pData)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(m_pData);
+#else
+		munmap(const_cast<char*>(m_pData), m_Size);
+#endif
+	}
+}
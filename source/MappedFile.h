@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Read only view of a whole file, the OS pages it in on first access
+	//An empty file opens fine with no data.
+	class MappedFile final
+	{
+	public:
+		explicit MappedFile(const std::string& filePath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+	};
+}
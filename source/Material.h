@@ -1,44 +1,42 @@
 #pragma once
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+#pragma region Material TYPES
+	//Materials are plain values without a common base class, a MaterialPool stores every type in its own array
+	//Every type has a non-virtual Shade(hitRecord, l, v) const with l the light direction and v the view direction
+	enum class MaterialType : uint8_t
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence,
+		//Keep last
+		Count
 	};
 #pragma endregion
 
 #pragma region Material SOLID COLOR
 	//SOLID COLOR
 	//===========
-	class Material_SolidColor final : public Material
+	class Material_SolidColor final
 	{
 	public:
+		static constexpr MaterialType TYPE{ MaterialType::SolidColor };
+
 		Material_SolidColor(const ColorRGB& color): m_Color(color)
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
 			return m_Color;
 		}
@@ -51,17 +49,17 @@ namespace dae
 #pragma region Material LAMBERT
 	//LAMBERT
 	//=======
-	class Material_Lambert final : public Material
+	class Material_Lambert final
 	{
 	public:
+		static constexpr MaterialType TYPE{ MaterialType::Lambert };
+
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
-			//todo: W3
-			assert(false && "Not Implemented Yet");
-			return {};
+			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
 	private:
@@ -73,16 +71,18 @@ namespace dae
 #pragma region Material LAMBERT PHONG
 	//LAMBERT-PHONG
 	//=============
-	class Material_LambertPhong final : public Material
+	class Material_LambertPhong final
 	{
 	public:
+		static constexpr MaterialType TYPE{ MaterialType::LambertPhong };
+
 		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent):
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
 			m_PhongExponent(phongExponent)
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
 			//todo: W3
 			assert(false && "Not Implemented Yet");
@@ -99,15 +99,17 @@ namespace dae
 
 #pragma region Material COOK TORRENCE
 	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
+	class Material_CookTorrence final
 	{
 	public:
+		static constexpr MaterialType TYPE{ MaterialType::CookTorrence };
+
 		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness):
 			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
 			//todo: W3
 			assert(false && "Not Implemented Yet");
@@ -120,4 +122,123 @@ namespace dae
 		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
 #pragma endregion
+
+#pragma region Material POOL
+	//Materials by value, one array per type, materialIndex picks a type and a slot in its array
+	//Shading switches on the type instead of calling through a vtable, ShadeBatch runs one non-virtual loop per type
+	class MaterialPool final
+	{
+	public:
+		//materialIndex is a byte everywhere (geometry, HitRecord, the shade bins)
+		static constexpr size_t MAX_MATERIALS{ 256 };
+
+		//Past MAX_MATERIALS the material isn't added and index 0 (the scene's default) is returned, asserts in debug
+		template<typename MaterialT>
+		unsigned char Add(const MaterialT& material)
+		{
+			assert(m_Entries.size() < MAX_MATERIALS && "MaterialPool is full, materialIndex is a byte");
+			if (m_Entries.size() >= MAX_MATERIALS)
+				return 0;
+
+			std::vector<MaterialT>& materials{ GetArray<MaterialT>() };
+			m_Entries.push_back({ MaterialT::TYPE, static_cast<uint32_t>(materials.size()) });
+			materials.push_back(material);
+			return static_cast<unsigned char>(m_Entries.size() - 1);
+		}
+
+		size_t GetSize() const { return m_Entries.size(); }
+		MaterialType GetType(unsigned char materialIndex) const { return m_Entries[materialIndex].type; }
+
+		ColorRGB Shade(unsigned char materialIndex, const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const;
+
+		//Shades pIndices[0..count), all of them have to use materials of the given type
+		//Index i reads pHitRecords[i] (for its material index), pL[i] and pV[i] and writes pColors[i]
+		void ShadeBatch(MaterialType type, const uint32_t* pIndices, uint32_t count, const HitRecord* pHitRecords, const Vector3* pL, const Vector3* pV, ColorRGB* pColors) const;
+		//Same for the lanes of a packet, every set bit of laneMask is an index
+		void ShadeBatch(MaterialType type, uint32_t laneMask, const HitRecord* pHitRecords, const Vector3* pL, const Vector3* pV, ColorRGB* pColors) const;
+
+	private:
+		struct Entry
+		{
+			MaterialType type{};
+			uint32_t slot{};
+		};
+
+		std::vector<Entry> m_Entries{};
+		std::vector<Material_SolidColor> m_SolidColors{};
+		std::vector<Material_Lambert> m_Lamberts{};
+		std::vector<Material_LambertPhong> m_LambertPhongs{};
+		std::vector<Material_CookTorrence> m_CookTorrences{};
+
+		template<typename MaterialT>
+		std::vector<MaterialT>& GetArray()
+		{
+			if constexpr (MaterialT::TYPE == MaterialType::SolidColor)
+				return m_SolidColors;
+			else if constexpr (MaterialT::TYPE == MaterialType::Lambert)
+				return m_Lamberts;
+			else if constexpr (MaterialT::TYPE == MaterialType::LambertPhong)
+				return m_LambertPhongs;
+			else
+				return m_CookTorrences;
+		}
+
+		template<typename MaterialT>
+		void ShadeBatch(const std::vector<MaterialT>& materials, const uint32_t* pIndices, uint32_t count, const HitRecord* pHitRecords, const Vector3* pL, const Vector3* pV, ColorRGB* pColors) const
+		{
+			for (uint32_t batchIndex{}; batchIndex < count; ++batchIndex)
+			{
+				const uint32_t index{ pIndices[batchIndex] };
+				const HitRecord& hitRecord{ pHitRecords[index] };
+				pColors[index] = materials[m_Entries[hitRecord.materialIndex].slot].Shade(hitRecord, pL[index], pV[index]);
+			}
+		}
+	};
+
+	inline ColorRGB MaterialPool::Shade(unsigned char materialIndex, const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
+	{
+		const Entry& entry{ m_Entries[materialIndex] };
+		switch (entry.type)
+		{
+		case MaterialType::SolidColor:
+			return m_SolidColors[entry.slot].Shade(hitRecord, l, v);
+		case MaterialType::Lambert:
+			return m_Lamberts[entry.slot].Shade(hitRecord, l, v);
+		case MaterialType::LambertPhong:
+			return m_LambertPhongs[entry.slot].Shade(hitRecord, l, v);
+		default:
+			return m_CookTorrences[entry.slot].Shade(hitRecord, l, v);
+		}
+	}
+
+	inline void MaterialPool::ShadeBatch(MaterialType type, const uint32_t* pIndices, uint32_t count, const HitRecord* pHitRecords, const Vector3* pL, const Vector3* pV, ColorRGB* pColors) const
+	{
+		switch (type)
+		{
+		case MaterialType::SolidColor:
+			ShadeBatch(m_SolidColors, pIndices, count, pHitRecords, pL, pV, pColors);
+			break;
+		case MaterialType::Lambert:
+			ShadeBatch(m_Lamberts, pIndices, count, pHitRecords, pL, pV, pColors);
+			break;
+		case MaterialType::LambertPhong:
+			ShadeBatch(m_LambertPhongs, pIndices, count, pHitRecords, pL, pV, pColors);
+			break;
+		default:
+			ShadeBatch(m_CookTorrences, pIndices, count, pHitRecords, pL, pV, pColors);
+			break;
+		}
+	}
+
+	inline void MaterialPool::ShadeBatch(MaterialType type, uint32_t laneMask, const HitRecord* pHitRecords, const Vector3* pL, const Vector3* pV, ColorRGB* pColors) const
+	{
+		uint32_t lanes[32];
+		uint32_t count{};
+		for (; laneMask != 0; laneMask &= laneMask - 1)
+		{
+			lanes[count++] = static_cast<uint32_t>(std::countr_zero(laneMask));
+		}
+		ShadeBatch(type, lanes, count, pHitRecords, pL, pV, pColors);
+	}
+#pragma endregion
 }
@@ -6,53 +6,65 @@
 #include <cmath>
 
 namespace dae {
-	Matrix::Matrix(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis, const Vector3& t) :
-		Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+	namespace
 	{
-	}
+#if DAE_SIMD_X64
+		//8 Vector3s (24 floats) to x, y, z registers and back, the same blend + permute shuffle as the ColorQuantizer's
+		//Interleave applies the inverse permutations, then the inverse blends
+		DAE_TARGET_AVX2 inline void Deinterleave_AVX2(const float* pFloats, __m256& x, __m256& y, __m256& z)
+		{
+			const __m256 load0{ _mm256_loadu_ps(pFloats) };
+			const __m256 load1{ _mm256_loadu_ps(pFloats + 8) };
+			const __m256 load2{ _mm256_loadu_ps(pFloats + 16) };
 
-	Matrix::Matrix(const Vector4& xAxis, const Vector4& yAxis, const Vector4& zAxis, const Vector4& t)
-	{
-		data[0] = xAxis;
-		data[1] = yAxis;
-		data[2] = zAxis;
-		data[3] = t;
-	}
+			x = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x92), load2, 0x24), _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+			y = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x24), load2, 0x49), _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+			z = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(load0, load1, 0x49), load2, 0x92), _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+		}
 
-	Matrix::Matrix(const Matrix& m)
-	{
-		data[0] = m[0];
-		data[1] = m[1];
-		data[2] = m[2];
-		data[3] = m[3];
-	}
+		DAE_TARGET_AVX2 inline void Interleave_AVX2(__m256 x, __m256 y, __m256 z, float* pFloats)
+		{
+			x = _mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+			y = _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+			z = _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
 
-	Vector3 Matrix::TransformVector(const Vector3& v) const
-	{
-		return TransformVector(v[0], v[1], v[2]);
-	}
+			_mm256_storeu_ps(pFloats, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x92), z, 0x24));
+			_mm256_storeu_ps(pFloats + 8, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x24), z, 0x49));
+			_mm256_storeu_ps(pFloats + 16, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x49), z, 0x92));
+		}
 
-	Vector3 Matrix::TransformVector(float x, float y, float z) const
-	{
-		return Vector3{
-			data[0].x * x + data[1].x * y + data[2].x * z,
-			data[0].y * x + data[1].y * y + data[2].y * z,
-			data[0].z * x + data[1].z * y + data[2].z * z
-		};
-	}
+		//One output component for 8 inputs, summed in the same order as Matrix::TransformPoint
+		template<bool IsPoint>
+		DAE_TARGET_AVX2 inline __m256 TransformComponent_AVX2(const Matrix& m, int component, __m256 x, __m256 y, __m256 z)
+		{
+			__m256 result{ _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][component]), x), _mm256_mul_ps(_mm256_set1_ps(m[1][component]), y)),
+				_mm256_mul_ps(_mm256_set1_ps(m[2][component]), z)) };
+			if constexpr (IsPoint)
+				result = _mm256_add_ps(result, _mm256_set1_ps(m[3][component]));
+			return result;
+		}
 
-	Vector3 Matrix::TransformPoint(const Vector3& p) const
-	{
-		return TransformPoint(p[0], p[1], p[2]);
-	}
+		//Returns how many were transformed, the caller does the rest one by one
+		template<bool IsPoint>
+		DAE_TARGET_AVX2 size_t Transform_AVX2(const Matrix& m, const Vector3* pIn, Vector3* pOut, size_t count)
+		{
+			static_assert(sizeof(Vector3) == 3 * sizeof(float));
 
-	Vector3 Matrix::TransformPoint(float x, float y, float z) const
-	{
-		return Vector3{
-			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
-			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
-			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
-		};
+			size_t index{};
+			for (; index + 8 <= count; index += 8)
+			{
+				__m256 x{}, y{}, z{};
+				Deinterleave_AVX2(&pIn[index].x, x, y, z);
+				Interleave_AVX2(
+					TransformComponent_AVX2<IsPoint>(m, 0, x, y, z),
+					TransformComponent_AVX2<IsPoint>(m, 1, x, y, z),
+					TransformComponent_AVX2<IsPoint>(m, 2, x, y, z),
+					&pOut[index].x);
+			}
+			return index;
+		}
+#endif
 	}
 
 	const Matrix& Matrix::Transpose()
@@ -82,31 +94,55 @@ namespace dae {
 		return out;
 	}
 
-	Vector3 Matrix::GetAxisX() const
+	void Matrix::TransformPoints(const Vector3* pIn, Vector3* pOut, size_t count, SIMD::InstructionSet instructionSet) const
 	{
-		return data[0];
+		size_t index{};
+#if DAE_SIMD_X64
+		if (instructionSet >= SIMD::InstructionSet::AVX2)
+			index = Transform_AVX2<true>(*this, pIn, pOut, count);
+#endif
+		for (; index < count; ++index)
+		{
+			pOut[index] = TransformPoint(pIn[index]);
+		}
 	}
 
-	Vector3 Matrix::GetAxisY() const
+	void Matrix::TransformVectors(const Vector3* pIn, Vector3* pOut, size_t count, SIMD::InstructionSet instructionSet) const
 	{
-		return data[1];
+		size_t index{};
+#if DAE_SIMD_X64
+		if (instructionSet >= SIMD::InstructionSet::AVX2)
+			index = Transform_AVX2<false>(*this, pIn, pOut, count);
+#endif
+		for (; index < count; ++index)
+		{
+			pOut[index] = TransformVector(pIn[index]);
+		}
 	}
 
-	Vector3 Matrix::GetAxisZ() const
+	Matrix Matrix::Inverse(const Matrix& m)
 	{
-		return data[2];
-	}
+		const Vector3 xAxis{ m.GetAxisX() };
+		const Vector3 yAxis{ m.GetAxisY() };
+		const Vector3 zAxis{ m.GetAxisZ() };
 
-	Vector3 Matrix::GetTranslation() const
-	{
-		return data[3];
+		//Inverse of the 3x3 part: the cross products of its rows, as columns, over the determinant
+		const Vector3 yz{ Vector3::Cross(yAxis, zAxis) };
+		const Vector3 zx{ Vector3::Cross(zAxis, xAxis) };
+		const Vector3 xy{ Vector3::Cross(xAxis, yAxis) };
+		const float inverseDeterminant{ 1.f / Vector3::Dot(xAxis, yz) };
+
+		const Vector3 inverseX{ Vector3{ yz.x, zx.x, xy.x } * inverseDeterminant };
+		const Vector3 inverseY{ Vector3{ yz.y, zx.y, xy.y } * inverseDeterminant };
+		const Vector3 inverseZ{ Vector3{ yz.z, zx.z, xy.z } * inverseDeterminant };
+
+		const Vector3 t{ m.GetTranslation() };
+		return { inverseX, inverseY, inverseZ, -(inverseX * t.x + inverseY * t.y + inverseZ * t.z) };
 	}
 
 	Matrix Matrix::CreateTranslation(float x, float y, float z)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		return CreateTranslation({ x, y, z });
 	}
 
 	Matrix Matrix::CreateTranslation(const Vector3& t)
@@ -116,30 +152,46 @@ namespace dae {
 
 	Matrix Matrix::CreateRotationX(float pitch)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		const float cosPitch{ cosf(pitch) };
+		const float sinPitch{ sinf(pitch) };
+
+		return {
+			{ 1, 0, 0 },
+			{ 0, cosPitch, sinPitch },
+			{ 0, -sinPitch, cosPitch },
+			Vector3::Zero
+		};
 	}
 
 	Matrix Matrix::CreateRotationY(float yaw)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		const float cosYaw{ cosf(yaw) };
+		const float sinYaw{ sinf(yaw) };
+
+		return {
+			{ cosYaw, 0, -sinYaw },
+			{ 0, 1, 0 },
+			{ sinYaw, 0, cosYaw },
+			Vector3::Zero
+		};
 	}
 
 	Matrix Matrix::CreateRotationZ(float roll)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		const float cosRoll{ cosf(roll) };
+		const float sinRoll{ sinf(roll) };
+
+		return {
+			{ cosRoll, sinRoll, 0 },
+			{ -sinRoll, cosRoll, 0 },
+			{ 0, 0, 1 },
+			Vector3::Zero
+		};
 	}
 
 	Matrix Matrix::CreateRotation(const Vector3& r)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		return CreateRotationX(r[0]) * CreateRotationY(r[1]) * CreateRotationZ(r[2]);
 	}
 
 	Matrix Matrix::CreateRotation(float pitch, float yaw, float roll)
@@ -149,9 +201,7 @@ namespace dae {
 
 	Matrix Matrix::CreateScale(float sx, float sy, float sz)
 	{
-		//todo W2
-		assert(false && "Not Implemented Yet");
-		return {};
+		return { { sx, 0, 0 }, { 0, sy, 0 }, { 0, 0, sz }, Vector3::Zero };
 	}
 
 	Matrix Matrix::CreateScale(const Vector3& s)
@@ -160,48 +210,15 @@ namespace dae {
 	}
 
 #pragma region Operator Overloads
-	Vector4& Matrix::operator[](int index)
-	{
-		assert(index <= 3 && index >= 0);
-		return data[index];
-	}
-
-	Vector4 Matrix::operator[](int index) const
-	{
-		assert(index <= 3 && index >= 0);
-		return data[index];
-	}
-
-	Matrix Matrix::operator*(const Matrix& m) const
+	bool Matrix::operator==(const Matrix& m) const
 	{
-		Matrix result{};
-		Matrix m_transposed = Transpose(m);
-
-		for (int r{ 0 }; r < 4; ++r)
+		for (int row{}; row < 4; ++row)
 		{
-			for (int c{ 0 }; c < 4; ++c)
-			{
-				result[r][c] = Vector4::Dot(data[r], m_transposed[c]);
-			}
+			if (data[row].x != m.data[row].x || data[row].y != m.data[row].y
+				|| data[row].z != m.data[row].z || data[row].w != m.data[row].w)
+				return false;
 		}
-
-		return result;
-	}
-
-	const Matrix& Matrix::operator*=(const Matrix& m)
-	{
-		Matrix copy{ *this };
-		Matrix m_transposed = Transpose(m);
-
-		for (int r{ 0 }; r < 4; ++r)
-		{
-			for (int c{ 0 }; c < 4; ++c)
-			{
-				data[r][c] = Vector4::Dot(copy[r], m_transposed[c]);
-			}
-		}
-
-		return *this;
+		return true;
 	}
 #pragma endregion
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include <cassert>
+#include <cstddef>
+
+#include "SIMD.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
@@ -10,26 +14,60 @@ namespace dae {
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
 		Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v.x, v.y, v.z);
+		}
+
+		Vector3 TransformVector(float x, float y, float z) const
+		{
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+		}
+
+		Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z);
+		}
+
+		Vector3 TransformPoint(float x, float y, float z) const
+		{
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+		}
 
-		Matrix(const Matrix& m);
+		//Batch versions, pIn and pOut may be the same array
+		//Eight at a time with AVX2 when the CPU has it, the results are the same bits as the single ones
+		//The single ones stay scalar: packing one Vector3 in and out of a register costs more than it saves
+		void TransformPoints(const Vector3* pIn, Vector3* pOut, size_t count, SIMD::InstructionSet instructionSet = SIMD::GetInstructionSet()) const;
+		void TransformVectors(const Vector3* pIn, Vector3* pOut, size_t count, SIMD::InstructionSet instructionSet = SIMD::GetInstructionSet()) const;
 
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
 		const Matrix& Transpose();
 
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
+		Vector3 GetAxisX() const { return data[0]; }
+		Vector3 GetAxisY() const { return data[1]; }
+		Vector3 GetAxisZ() const { return data[2]; }
+		Vector3 GetTranslation() const { return data[3]; }
 
 		static Matrix CreateTranslation(float x, float y, float z);
 		static Matrix CreateTranslation(const Vector3& t);
@@ -41,11 +79,50 @@ namespace dae {
 		static Matrix CreateScale(float sx, float sy, float sz);
 		static Matrix CreateScale(const Vector3& s);
 		static Matrix Transpose(const Matrix& m);
+		//Affine matrices only (rotation/scale/translation, last column 0,0,0,1)
+		static Matrix Inverse(const Matrix& m);
+
+		Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		const Vector4& operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		//Every result row is the rows of m weighted by this row, summed in x, y, z, w order like the dot products it replaces
+		Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+#if DAE_SIMD_X64
+				const __m128 row{ _mm_add_ps(
+					_mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[r].x), m.data[0].Load()), _mm_mul_ps(_mm_set1_ps(data[r].y), m.data[1].Load())),
+						_mm_mul_ps(_mm_set1_ps(data[r].z), m.data[2].Load())),
+					_mm_mul_ps(_mm_set1_ps(data[r].w), m.data[3].Load())) };
+				result.data[r] = Vector4{ row };
+#else
+				result.data[r] = m.data[0] * data[r].x + m.data[1] * data[r].y + m.data[2] * data[r].z + m.data[3] * data[r].w;
+#endif
+			}
+
+			return result;
+		}
+
+		const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
 
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+		//Exact comparison, meant for change detection
+		bool operator==(const Matrix& m) const;
 
 	private:
 
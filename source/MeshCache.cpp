@@ -0,0 +1,228 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr char MAGIC[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+		constexpr size_t SECTION_ALIGNMENT{ 16 };
+
+		struct Header
+		{
+			char magic[8]{};
+			uint32_t version{};
+			uint32_t leafBatchSize{};
+			uint64_t sourceHash{};
+			uint64_t positionCount{};
+			uint64_t normalCount{};
+			uint64_t indexCount{};
+			uint64_t nodeCount{};
+			uint64_t primitiveIndexCount{};
+		};
+
+		static_assert(sizeof(Vector3) == 12 && sizeof(BVHNode) == 32, "Bump MeshCache::VERSION when the cached types change");
+
+		size_t AlignSection(size_t offset)
+		{
+			return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		}
+
+		//Section sizes in order, shared by Write and Read so both agree on the offsets
+		size_t GetSectionSizes(const Header& header, size_t (&sizes)[5])
+		{
+			sizes[0] = header.positionCount * sizeof(Vector3);
+			sizes[1] = header.normalCount * sizeof(Vector3);
+			sizes[2] = header.indexCount * sizeof(int);
+			sizes[3] = header.nodeCount * sizeof(BVHNode);
+			sizes[4] = header.primitiveIndexCount * sizeof(uint32_t);
+
+			size_t fileSize{ sizeof(Header) };
+			for (const size_t size : sizes)
+				fileSize = AlignSection(fileSize) + size;
+			return fileSize;
+		}
+
+		template<typename T>
+		void ReadSection(const char*& pData, size_t size, std::vector<T>& values)
+		{
+			pData = reinterpret_cast<const char*>(AlignSection(reinterpret_cast<uintptr_t>(pData)));
+			values.resize(size / sizeof(T));
+			std::memcpy(values.data(), pData, size);
+			pData += size;
+		}
+	}
+
+	namespace MeshCache
+	{
+		std::string GetCachePath(const std::string& sourcePath)
+		{
+			return sourcePath + ".meshcache";
+		}
+
+		bool HashFile(const std::string& filePath, uint64_t& hash)
+		{
+			DAE_PROFILE_ZONE("MeshCache::HashFile");
+			const MappedFile file{ filePath };
+			if (!file.IsOpen())
+				return false;
+
+			//FNV-1a over 8 byte words with an extra fold so high bits reach the low ones, then the tail byte by byte
+			constexpr uint64_t PRIME{ 1099511628211ull };
+			const char* pData{ file.GetData() };
+			const size_t size{ file.GetSize() };
+
+			hash = 14695981039346656037ull ^ size;
+			size_t index{};
+			for (; index + sizeof(uint64_t) <= size; index += sizeof(uint64_t))
+			{
+				uint64_t word{};
+				std::memcpy(&word, pData + index, sizeof(word));
+				hash = (hash ^ word) * PRIME;
+				hash ^= hash >> 32;
+			}
+			for (; index < size; ++index)
+			{
+				hash = (hash ^ static_cast<uint8_t>(pData[index])) * PRIME;
+			}
+			return true;
+		}
+
+		bool Write(const std::string& cachePath, const TriangleMesh& mesh, uint64_t sourceHash)
+		{
+			DAE_PROFILE_ZONE("MeshCache::Write");
+
+			Header header{};
+			std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.leafBatchSize = mesh.bvh.GetLeafBatchSize();
+			header.sourceHash = sourceHash;
+			header.positionCount = mesh.positions.size();
+			header.normalCount = mesh.normals.size();
+			header.indexCount = mesh.indices.size();
+			header.nodeCount = mesh.bvh.GetNodes().size();
+			header.primitiveIndexCount = mesh.bvh.GetPrimitiveIndices().size();
+
+			size_t sizes[5]{};
+			GetSectionSizes(header, sizes);
+			const void* sections[5]{ mesh.positions.data(), mesh.normals.data(), mesh.indices.data(),
+				mesh.bvh.GetNodes().data(), mesh.bvh.GetPrimitiveIndices().data() };
+
+			const std::string temporaryPath{ cachePath + ".tmp" };
+			bool isWritten{};
+			{
+				std::ofstream file{ temporaryPath, std::ios::binary };
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				size_t offset{ sizeof(header) };
+				for (int section{}; section < 5; ++section)
+				{
+					const char padding[SECTION_ALIGNMENT]{};
+					file.write(padding, static_cast<std::streamsize>(AlignSection(offset) - offset));
+					file.write(static_cast<const char*>(sections[section]), static_cast<std::streamsize>(sizes[section]));
+					offset = AlignSection(offset) + sizes[section];
+				}
+
+				file.close();
+				isWritten = static_cast<bool>(file);
+			}
+
+			std::error_code error{};
+			if (isWritten)
+				std::filesystem::rename(temporaryPath, cachePath, error);
+			if (!isWritten || error)
+			{
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+			return true;
+		}
+
+		bool Read(const std::string& cachePath, TriangleMesh& mesh, uint64_t sourceHash)
+		{
+			DAE_PROFILE_ZONE("MeshCache::Read");
+			const MappedFile file{ cachePath };
+			if (!file.IsOpen() || file.GetSize() < sizeof(Header))
+				return false;
+
+			Header header{};
+			std::memcpy(&header, file.GetData(), sizeof(header));
+			if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.sourceHash != sourceHash)
+				return false;
+
+			//A tree built for another leaf batch size would trace correctly but not as fast, LoadOBJ then rebuilds and rewrites it
+			if (header.leafBatchSize != mesh.bvh.GetLeafBatchSize())
+				return false;
+
+			//The tracer reads normals[triangleIndex]
+			size_t sizes[5]{};
+			if (GetSectionSizes(header, sizes) != file.GetSize() || header.indexCount % 3 != 0 || header.normalCount != header.indexCount / 3)
+				return false;
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<int> indices{};
+			std::vector<BVHNode> nodes{};
+			std::vector<uint32_t> primitiveIndices{};
+
+			//The mapping is page aligned, so the sections land on the same alignment they were written with
+			const char* pData{ file.GetData() + sizeof(Header) };
+			ReadSection(pData, sizes[0], positions);
+			ReadSection(pData, sizes[1], normals);
+			ReadSection(pData, sizes[2], indices);
+			ReadSection(pData, sizes[3], nodes);
+			ReadSection(pData, sizes[4], primitiveIndices);
+
+			//Damaged files must not send the tracer out of bounds, checking is cheap next to reading the file
+			for (const int index : indices)
+			{
+				if (index < 0 || static_cast<uint64_t>(index) >= header.positionCount)
+					return false;
+			}
+			for (const BVHNode& node : nodes)
+			{
+				const uint64_t end{ uint64_t(node.leftFirst) + (node.IsLeaf() ? node.primitiveCount : 2) };
+				if (end > (node.IsLeaf() ? primitiveIndices.size() : nodes.size()))
+					return false;
+			}
+			for (const uint32_t primitiveIndex : primitiveIndices)
+			{
+				if (primitiveIndex >= header.indexCount / 3)
+					return false;
+			}
+
+			mesh.positions = std::move(positions);
+			mesh.normals = std::move(normals);
+			mesh.indices = std::move(indices);
+			mesh.MarkVerticesDirty();
+			mesh.AssignBVH(std::move(nodes), std::move(primitiveIndices));
+			return true;
+		}
+
+		bool LoadOBJ(const std::string& objPath, TriangleMesh& mesh, ThreadPool* pThreadPool)
+		{
+			uint64_t sourceHash{};
+			if (!HashFile(objPath, sourceHash))
+				return false;
+
+			const std::string cachePath{ GetCachePath(objPath) };
+			if (Read(cachePath, mesh, sourceHash))
+				return true;
+
+			if (!Utils::ParseOBJ(objPath, mesh.positions, mesh.normals, mesh.indices, pThreadPool))
+				return false;
+			mesh.MarkVerticesDirty();
+			mesh.UpdateBVH();
+
+			Write(cachePath, mesh, sourceHash);
+			return true;
+		}
+	}
+}
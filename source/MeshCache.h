@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	class ThreadPool;
+	struct TriangleMesh;
+
+	//Binary copy of a loaded mesh: positions, per-triangle normals, indices and the mesh's BVH, keyed by a hash of the source file
+	//A header followed by the arrays, each 16 byte aligned, in native endianness and struct layout:
+	//a cache is only meant for the machine that wrote it, VERSION goes up whenever the layout changes.
+	namespace MeshCache
+	{
+		constexpr uint32_t VERSION{ 1 };
+
+		//Next to the source file, <source>.meshcache
+		std::string GetCachePath(const std::string& sourcePath);
+
+		//64 bit hash of the file's bytes, false if it can't be read
+		bool HashFile(const std::string& filePath, uint64_t& hash);
+
+		//Written to a temporary file first, so a cache is never seen half written
+		bool Write(const std::string& cachePath, const TriangleMesh& mesh, uint64_t sourceHash);
+		//False (mesh untouched) when the cache is missing, from another version or source, damaged
+		//or its BVH was built for another leaf batch size than mesh.bvh has
+		bool Read(const std::string& cachePath, TriangleMesh& mesh, uint64_t sourceHash);
+
+		//Reads the OBJ's cache when it is up to date, otherwise parses the OBJ, builds the BVH and writes the cache
+		//Only fails when the OBJ itself can't be loaded, a cache that can't be written is skipped.
+		bool LoadOBJ(const std::string& objPath, TriangleMesh& mesh, ThreadPool* pThreadPool = nullptr);
+	}
+}
@@ -0,0 +1,479 @@
+#include "OBJLoader.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Chunks smaller than this aren't worth a task
+		constexpr size_t MIN_CHUNK_SIZE{ 1 << 20 };
+		constexpr uint32_t CHUNKS_PER_THREAD{ 4 };
+
+#pragma region Number parsing
+		//No locale, no allocation, no error state: the parsers stop at the first character that doesn't belong to the number
+		inline bool IsDigit(char character)
+		{
+			return static_cast<unsigned char>(character - '0') < 10;
+		}
+
+		inline void SkipSpaces(const char*& pText, const char* pEnd)
+		{
+			while (pText < pEnd && (*pText == ' ' || *pText == '\t'))
+				++pText;
+		}
+
+		inline bool ParseInt(const char*& pText, const char* pEnd, int& value)
+		{
+			bool isNegative{ false };
+			if (pText < pEnd && (*pText == '-' || *pText == '+'))
+				isNegative = *pText++ == '-';
+
+			if (pText == pEnd || !IsDigit(*pText))
+				return false;
+
+			int64_t result{};
+			while (pText < pEnd && IsDigit(*pText))
+			{
+				result = std::min(result * 10 + (*pText++ - '0'), int64_t(INT32_MAX));
+			}
+			value = static_cast<int>(isNegative ? -result : result);
+			return true;
+		}
+
+		//Up to 19 significant digits are kept in an integer and scaled by a power of ten in double precision, then rounded to float once more
+		inline bool ParseFloat(const char*& pText, const char* pEnd, float& value)
+		{
+			constexpr double POWERS_OF_TEN[]{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			constexpr int MAX_DIGITS{ 19 };
+
+			bool isNegative{ false };
+			if (pText < pEnd && (*pText == '-' || *pText == '+'))
+				isNegative = *pText++ == '-';
+
+			uint64_t mantissa{};
+			int numDigits{};
+			int exponent{};
+			bool hasDigits{ false };
+
+			for (; pText < pEnd && IsDigit(*pText); ++pText)
+			{
+				hasDigits = true;
+				if (numDigits < MAX_DIGITS)
+				{
+					mantissa = mantissa * 10 + (*pText - '0');
+					numDigits += mantissa != 0;
+				}
+				else
+				{
+					++exponent;
+				}
+			}
+
+			if (pText < pEnd && *pText == '.')
+			{
+				for (++pText; pText < pEnd && IsDigit(*pText); ++pText)
+				{
+					hasDigits = true;
+					if (numDigits < MAX_DIGITS)
+					{
+						mantissa = mantissa * 10 + (*pText - '0');
+						numDigits += mantissa != 0;
+						--exponent;
+					}
+				}
+			}
+
+			if (!hasDigits)
+				return false;
+
+			if (pText < pEnd && (*pText == 'e' || *pText == 'E'))
+			{
+				const char* pExponent{ pText + 1 };
+				int explicitExponent{};
+				if (ParseInt(pExponent, pEnd, explicitExponent))
+				{
+					exponent += explicitExponent;
+					pText = pExponent;
+				}
+			}
+
+			double result{ static_cast<double>(mantissa) };
+			if (mantissa != 0 && exponent != 0)
+			{
+				if (exponent > 0)
+					result = exponent < int(std::size(POWERS_OF_TEN)) ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+				else
+					result = -exponent < int(std::size(POWERS_OF_TEN)) ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+			}
+
+			value = static_cast<float>(isNegative ? -result : result);
+			return true;
+		}
+#pragma endregion
+
+#pragma region Chunks
+		//0 based indices into the file's attributes, -1 for an unused attribute
+		struct Corner
+		{
+			int position{};
+			int texCoord{};
+			int normal{};
+		};
+
+		//Negative indices count back from the attributes parsed so far, which only the chunk knows
+		//They are stored relative to the chunk's first attribute and flagged, Resolve adds the chunk's offset
+		enum CornerFlags : uint8_t
+		{
+			RelativePosition = 1 << 0,
+			RelativeTexCoord = 1 << 1,
+			RelativeNormal = 1 << 2
+		};
+
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<TexCoord> texCoords{};
+
+			//Three per triangle, polygons already fanned out
+			std::vector<Corner> corners{};
+			std::vector<uint8_t> cornerFlags{};
+
+			//First position/texCoord/normal of the chunk in the whole file
+			size_t positionOffset{};
+			size_t texCoordOffset{};
+			size_t normalOffset{};
+
+			bool hasTexCoords{ false };
+			bool hasNormals{ false };
+			bool isValid{ true };
+		};
+
+		inline bool ParseIndex(const char*& pText, const char* pEnd, size_t count, int& index, uint8_t& flags, uint8_t relativeFlag)
+		{
+			int value{};
+			if (!ParseInt(pText, pEnd, value) || value == 0)
+				return false;
+
+			if (value < 0)
+			{
+				index = static_cast<int>(count) + value;
+				flags |= relativeFlag;
+			}
+			else
+			{
+				index = value - 1;
+			}
+			return true;
+		}
+
+		//One corner: v, v/vt, v//vn or v/vt/vn
+		inline bool ParseCorner(const char*& pText, const char* pEnd, Chunk& chunk, Corner& corner, uint8_t& flags)
+		{
+			corner = { 0, -1, -1 };
+			flags = 0;
+
+			if (!ParseIndex(pText, pEnd, chunk.positions.size(), corner.position, flags, RelativePosition))
+				return false;
+			if (pText == pEnd || *pText != '/')
+				return true;
+
+			++pText;
+			if (pText < pEnd && *pText != '/')
+			{
+				if (!ParseIndex(pText, pEnd, chunk.texCoords.size(), corner.texCoord, flags, RelativeTexCoord))
+					return false;
+				chunk.hasTexCoords = true;
+			}
+			if (pText == pEnd || *pText != '/')
+				return true;
+
+			++pText;
+			if (!ParseIndex(pText, pEnd, chunk.normals.size(), corner.normal, flags, RelativeNormal))
+				return false;
+			chunk.hasNormals = true;
+			return true;
+		}
+
+		inline bool IsLineEnd(const char* pText, const char* pEnd)
+		{
+			return pText == pEnd || *pText == '\n' || *pText == '\r' || *pText == '#';
+		}
+
+		bool ParseVector(const char*& pText, const char* pEnd, Vector3& vector)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				SkipSpaces(pText, pEnd);
+				if (!ParseFloat(pText, pEnd, vector[axis]))
+					return false;
+			}
+			return true;
+		}
+
+		bool ParseFace(const char*& pText, const char* pEnd, Chunk& chunk)
+		{
+			//Fan around the first corner
+			Corner first{}, previous{};
+			uint8_t firstFlags{}, previousFlags{};
+			int numCorners{};
+
+			SkipSpaces(pText, pEnd);
+			while (!IsLineEnd(pText, pEnd))
+			{
+				Corner corner{};
+				uint8_t flags{};
+				if (!ParseCorner(pText, pEnd, chunk, corner, flags))
+					return false;
+
+				if (numCorners == 0)
+				{
+					first = corner;
+					firstFlags = flags;
+				}
+				else if (numCorners >= 2)
+				{
+					chunk.corners.insert(chunk.corners.end(), { first, previous, corner });
+					chunk.cornerFlags.insert(chunk.cornerFlags.end(), { firstFlags, previousFlags, flags });
+				}
+				previous = corner;
+				previousFlags = flags;
+				++numCorners;
+
+				SkipSpaces(pText, pEnd);
+			}
+			return true;
+		}
+
+		void ParseChunk(Chunk& chunk)
+		{
+			DAE_PROFILE_ZONE("OBJLoader::ParseChunk");
+
+			const char* pText{ chunk.pBegin };
+			const char* pEnd{ chunk.pEnd };
+			while (pText < pEnd)
+			{
+				SkipSpaces(pText, pEnd);
+
+				bool isValid{ true };
+				if (pEnd - pText >= 2 && pText[0] == 'v' && (pText[1] == ' ' || pText[1] == '\t'))
+				{
+					pText += 2;
+					Vector3 position{};
+					isValid = ParseVector(pText, pEnd, position);
+					chunk.positions.push_back(position);
+				}
+				else if (pEnd - pText >= 3 && pText[0] == 'v' && pText[1] == 'n' && (pText[2] == ' ' || pText[2] == '\t'))
+				{
+					pText += 3;
+					Vector3 normal{};
+					isValid = ParseVector(pText, pEnd, normal);
+					chunk.normals.push_back(normal);
+				}
+				else if (pEnd - pText >= 3 && pText[0] == 'v' && pText[1] == 't' && (pText[2] == ' ' || pText[2] == '\t'))
+				{
+					//v is optional
+					pText += 3;
+					TexCoord texCoord{};
+					SkipSpaces(pText, pEnd);
+					isValid = ParseFloat(pText, pEnd, texCoord.u);
+					SkipSpaces(pText, pEnd);
+					if (isValid && !IsLineEnd(pText, pEnd))
+						isValid = ParseFloat(pText, pEnd, texCoord.v);
+					chunk.texCoords.push_back(texCoord);
+				}
+				else if (pEnd - pText >= 2 && pText[0] == 'f' && (pText[1] == ' ' || pText[1] == '\t'))
+				{
+					pText += 2;
+					isValid = ParseFace(pText, pEnd, chunk);
+				}
+
+				if (!isValid)
+				{
+					chunk.isValid = false;
+					return;
+				}
+
+				//Whatever is left: comments, w components, unsupported statements
+				pText = std::find(pText, pEnd, '\n');
+				if (pText < pEnd)
+					++pText;
+			}
+		}
+
+		//Makes every index absolute and checks it, unused attributes become -1
+		void ResolveChunk(Chunk& chunk, size_t numPositions, size_t numTexCoords, size_t numNormals)
+		{
+			const auto resolve = [](int& index, bool isRelative, size_t offset, size_t count)
+				{
+					if (isRelative)
+						index += static_cast<int>(offset);
+					return index >= 0 && static_cast<size_t>(index) < count;
+				};
+
+			for (size_t cornerIndex{}; cornerIndex < chunk.corners.size(); ++cornerIndex)
+			{
+				Corner& corner{ chunk.corners[cornerIndex] };
+				const uint8_t flags{ chunk.cornerFlags[cornerIndex] };
+
+				bool isValid{ resolve(corner.position, flags & RelativePosition, chunk.positionOffset, numPositions) };
+				if (corner.texCoord != -1 || (flags & RelativeTexCoord))
+					isValid &= resolve(corner.texCoord, flags & RelativeTexCoord, chunk.texCoordOffset, numTexCoords);
+				if (corner.normal != -1 || (flags & RelativeNormal))
+					isValid &= resolve(corner.normal, flags & RelativeNormal, chunk.normalOffset, numNormals);
+
+				if (!isValid)
+				{
+					chunk.isValid = false;
+					return;
+				}
+			}
+		}
+#pragma endregion
+	}
+
+	namespace OBJLoader
+	{
+		bool Load(const std::string& filePath, OBJMesh& mesh, ThreadPool* pThreadPool)
+		{
+			const MappedFile file{ filePath };
+			if (!file.IsOpen())
+			{
+				mesh = {};
+				return false;
+			}
+
+			return Parse(file.GetData(), file.GetSize(), mesh, pThreadPool);
+		}
+
+		bool Parse(const char* pText, size_t size, OBJMesh& mesh, ThreadPool* pThreadPool)
+		{
+			DAE_PROFILE_ZONE("OBJLoader::Parse");
+			mesh = {};
+
+			//Chunks end right after a line end, so no line is split
+			size_t numChunks{ 1 };
+			if (pThreadPool)
+				numChunks = std::clamp(size / MIN_CHUNK_SIZE, size_t(1), size_t(pThreadPool->GetThreadCount() * CHUNKS_PER_THREAD));
+
+			std::vector<Chunk> chunks(numChunks);
+			const char* pEnd{ pText + size };
+			const char* pChunkBegin{ pText };
+			for (size_t chunkIndex{}; chunkIndex < numChunks; ++chunkIndex)
+			{
+				const char* pChunkEnd{ chunkIndex + 1 == numChunks ? pEnd : std::min(pText + size * (chunkIndex + 1) / numChunks, pEnd) };
+				pChunkEnd = std::max(pChunkEnd, pChunkBegin);
+				pChunkEnd = pChunkEnd == pEnd ? pEnd : std::find(pChunkEnd, pEnd, '\n');
+				if (pChunkEnd < pEnd)
+					++pChunkEnd;
+
+				chunks[chunkIndex].pBegin = pChunkBegin;
+				chunks[chunkIndex].pEnd = pChunkEnd;
+				pChunkBegin = pChunkEnd;
+			}
+
+			const auto forEachChunk = [&](const auto& function)
+				{
+					if (pThreadPool && numChunks > 1)
+						pThreadPool->ParallelFor(static_cast<uint32_t>(numChunks), [&](uint32_t chunkIndex) { function(chunks[chunkIndex]); });
+					else
+						std::for_each(chunks.begin(), chunks.end(), function);
+				};
+
+			forEachChunk(ParseChunk);
+
+			//Prefix sums of the attribute counts
+			size_t numPositions{}, numTexCoords{}, numNormals{}, numCorners{};
+			bool hasTexCoords{ false }, hasNormals{ false };
+			for (Chunk& chunk : chunks)
+			{
+				if (!chunk.isValid)
+					return false;
+
+				chunk.positionOffset = numPositions;
+				chunk.texCoordOffset = numTexCoords;
+				chunk.normalOffset = numNormals;
+				numPositions += chunk.positions.size();
+				numTexCoords += chunk.texCoords.size();
+				numNormals += chunk.normals.size();
+				numCorners += chunk.corners.size();
+				hasTexCoords |= chunk.hasTexCoords;
+				hasNormals |= chunk.hasNormals;
+			}
+
+			forEachChunk([&](Chunk& chunk) { ResolveChunk(chunk, numPositions, numTexCoords, numNormals); });
+			if (std::any_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return !chunk.isValid; }))
+				return false;
+
+			DAE_PROFILE_ZONE("OBJLoader::Deduplicate");
+			mesh.indices.reserve(numCorners);
+
+			//Only positions referenced: the vertices are the file's positions, in file order
+			if (!hasTexCoords && !hasNormals)
+			{
+				mesh.positions.reserve(numPositions);
+				for (const Chunk& chunk : chunks)
+				{
+					mesh.positions.insert(mesh.positions.end(), chunk.positions.begin(), chunk.positions.end());
+					for (const Corner& corner : chunk.corners)
+						mesh.indices.push_back(corner.position);
+				}
+				return true;
+			}
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<TexCoord> texCoords{};
+			positions.reserve(numPositions);
+			normals.reserve(numNormals);
+			texCoords.reserve(numTexCoords);
+			for (const Chunk& chunk : chunks)
+			{
+				positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+				normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+				texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+			}
+
+			//Every position keeps a list of the vertices made from it, usually one or a few, so lookups are a short walk instead of a hash
+			std::vector<int> firstVertices(numPositions, -1);
+			std::vector<int> nextVertices{};
+			std::vector<Corner> vertexCorners{};
+			mesh.positions.reserve(numPositions);
+			for (const Chunk& chunk : chunks)
+			{
+				for (const Corner& corner : chunk.corners)
+				{
+					int vertexIndex{ firstVertices[corner.position] };
+					while (vertexIndex != -1 && (vertexCorners[vertexIndex].texCoord != corner.texCoord || vertexCorners[vertexIndex].normal != corner.normal))
+						vertexIndex = nextVertices[vertexIndex];
+
+					if (vertexIndex == -1)
+					{
+						vertexIndex = static_cast<int>(vertexCorners.size());
+						vertexCorners.push_back(corner);
+						nextVertices.push_back(firstVertices[corner.position]);
+						firstVertices[corner.position] = vertexIndex;
+
+						mesh.positions.push_back(positions[corner.position]);
+						if (hasNormals)
+							mesh.normals.push_back(corner.normal == -1 ? Vector3{} : normals[corner.normal]);
+						if (hasTexCoords)
+							mesh.texCoords.push_back(corner.texCoord == -1 ? TexCoord{} : texCoords[corner.texCoord]);
+					}
+					mesh.indices.push_back(vertexIndex);
+				}
+			}
+			return true;
+		}
+	}
+}
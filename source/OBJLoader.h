@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	class ThreadPool;
+
+	struct TexCoord
+	{
+		float u{};
+		float v{};
+	};
+
+	//Indexed triangles, every unique v/vt/vn combination of the file is one vertex
+	//normals and texCoords are per vertex and empty when no face references them, missing ones are zero
+	struct OBJMesh
+	{
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<TexCoord> texCoords{};
+		std::vector<int> indices{};
+
+		size_t GetTriangleCount() const { return indices.size() / 3; }
+	};
+
+	//Wavefront OBJ geometry: v, vt, vn and f with v, v/vt, v//vn and v/vt/vn corners
+	//Negative (relative) indices are resolved, polygons are fan triangulated, everything else (o, g, usemtl, ...) is skipped.
+	namespace OBJLoader
+	{
+		//The file is memory mapped and split into chunks at line ends, with a pool the chunks are parsed in parallel
+		//Returns false (and leaves mesh empty) when the file can't be opened, has a malformed line or an index out of range.
+		bool Load(const std::string& filePath, OBJMesh& mesh, ThreadPool* pThreadPool = nullptr);
+
+		//Same as Load, for text already in memory
+		bool Parse(const char* pText, size_t size, OBJMesh& mesh, ThreadPool* pThreadPool = nullptr);
+	}
+}
@@ -0,0 +1,223 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define DAE_PROFILE_TSC 1
+#else
+#define DAE_PROFILE_TSC 0
+#endif
+
+namespace dae
+{
+	namespace Profiler
+	{
+		namespace
+		{
+			struct Zone
+			{
+				const char* name;
+				uint64_t start;
+				uint64_t end;
+			};
+
+			struct ThreadBuffer
+			{
+				uint32_t threadIndex{};
+				std::vector<Zone> zones{};
+				//Zones recorded since the last Clear, the ring holds the last RING_BUFFER_SIZE of them
+				uint64_t zoneCount{};
+			};
+
+			//Buffers outlive their threads, so zones of finished threads still end up in the trace
+			//A finished thread's buffer goes to the next new thread, so restarting a pool doesn't add buffers
+			std::mutex g_BuffersMutex{};
+			std::vector<std::unique_ptr<ThreadBuffer>> g_Buffers{};
+			std::vector<ThreadBuffer*> g_FreeBuffers{};
+
+			class ThreadBufferHandle final
+			{
+			public:
+				ThreadBufferHandle() = default;
+				~ThreadBufferHandle()
+				{
+					if (!m_pBuffer)
+						return;
+
+					const std::lock_guard lock{ g_BuffersMutex };
+					g_FreeBuffers.push_back(m_pBuffer);
+				}
+
+				ThreadBufferHandle(const ThreadBufferHandle&) = delete;
+				ThreadBufferHandle(ThreadBufferHandle&&) noexcept = delete;
+				ThreadBufferHandle& operator=(const ThreadBufferHandle&) = delete;
+				ThreadBufferHandle& operator=(ThreadBufferHandle&&) noexcept = delete;
+
+				ThreadBuffer& Get()
+				{
+					if (!m_pBuffer)
+						m_pBuffer = Acquire();
+					return *m_pBuffer;
+				}
+
+			private:
+				ThreadBuffer* m_pBuffer{};
+
+				static ThreadBuffer* Acquire()
+				{
+					const std::lock_guard lock{ g_BuffersMutex };
+					if (!g_FreeBuffers.empty())
+					{
+						ThreadBuffer* pBuffer{ g_FreeBuffers.back() };
+						g_FreeBuffers.pop_back();
+						return pBuffer;
+					}
+
+					auto pBuffer{ std::make_unique<ThreadBuffer>() };
+					pBuffer->threadIndex = static_cast<uint32_t>(g_Buffers.size());
+					pBuffer->zones.resize(RING_BUFFER_SIZE);
+					g_Buffers.push_back(std::move(pBuffer));
+					return g_Buffers.back().get();
+				}
+			};
+
+			thread_local ThreadBufferHandle t_Buffer{};
+
+			constexpr const char* STAGE_NAMES[]{ "GenerateRays", "ClosestHit", "ShadowRays", "Shade" };
+			static_assert(std::size(STAGE_NAMES) == static_cast<size_t>(Stage::Count));
+
+			struct StageTimes
+			{
+				uint64_t startTimestamp{};
+				uint64_t lastTicks{};
+				uint64_t ticks[static_cast<int>(Stage::Count)]{};
+				bool isSampled{};
+			};
+
+			thread_local StageTimes t_Stages{};
+
+			//Stages end every few rays, so they read the TSC where there is one, the steady clock costs a lot more
+			uint64_t GetTicks()
+			{
+#if DAE_PROFILE_TSC
+				return __rdtsc();
+#else
+				return GetTimestamp();
+#endif
+			}
+		}
+
+		void RecordZone(const char* name, uint64_t start, uint64_t end)
+		{
+			ThreadBuffer& buffer{ t_Buffer.Get() };
+			buffer.zones[buffer.zoneCount % RING_BUFFER_SIZE] = { name, start, end };
+			++buffer.zoneCount;
+		}
+
+		bool WriteChromeTrace(const std::string& filePath)
+		{
+			const std::lock_guard lock{ g_BuffersMutex };
+
+			std::ofstream file{ filePath };
+			if (!file)
+				return false;
+
+			//Timestamps relative to the oldest zone, Chrome wants them in us
+			uint64_t firstStart{ UINT64_MAX };
+			for (const auto& pBuffer : g_Buffers)
+			{
+				const uint64_t count{ std::min(pBuffer->zoneCount, uint64_t(RING_BUFFER_SIZE)) };
+				for (uint64_t index{}; index < count; ++index)
+					firstStart = std::min(firstStart, pBuffer->zones[index].start);
+			}
+
+			file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool isFirstEvent{ true };
+			for (const auto& pBuffer : g_Buffers)
+			{
+				file << (isFirstEvent ? "\n" : ",\n")
+					<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << pBuffer->threadIndex
+					<< ",\"args\":{\"name\":\"Thread " << pBuffer->threadIndex << "\"}}";
+				isFirstEvent = false;
+
+				const uint64_t count{ std::min(pBuffer->zoneCount, uint64_t(RING_BUFFER_SIZE)) };
+				for (uint64_t index{}; index < count; ++index)
+				{
+					const Zone& zone{ pBuffer->zones[index] };
+					file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << pBuffer->threadIndex
+						<< ",\"ts\":" << (zone.start - firstStart) / 1000.0
+						<< ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+				}
+			}
+			file << "\n]}\n";
+
+			return static_cast<bool>(file);
+		}
+
+		void BeginStages()
+		{
+			t_Stages = {};
+			t_Stages.startTimestamp = GetTimestamp();
+			t_Stages.lastTicks = GetTicks();
+			t_Stages.isSampled = true;
+		}
+
+		void EndStage(Stage stage)
+		{
+			if (!t_Stages.isSampled)
+				return;
+
+			const uint64_t ticks{ GetTicks() };
+			t_Stages.ticks[static_cast<int>(stage)] += ticks - t_Stages.lastTicks;
+			t_Stages.lastTicks = ticks;
+		}
+
+		void SampleStages(bool isSampled)
+		{
+			t_Stages.isSampled = isSampled;
+			if (isSampled)
+				t_Stages.lastTicks = GetTicks();
+		}
+
+		void RecordStages()
+		{
+			const uint64_t endTimestamp{ GetTimestamp() };
+			uint64_t totalTicks{};
+			for (const uint64_t ticks : t_Stages.ticks)
+				totalTicks += ticks;
+			if (totalTicks == 0)
+				return;
+
+			//Ticks aren't ns and may only cover the sampled part, so each stage gets its share of the steady clock time
+			const double nsPerTick{ double(endTimestamp - t_Stages.startTimestamp) / totalTicks };
+			uint64_t start{ t_Stages.startTimestamp };
+			for (int stage{}; stage < static_cast<int>(Stage::Count); ++stage)
+			{
+				if (t_Stages.ticks[stage] == 0)
+					continue;
+
+				const uint64_t end{ start + static_cast<uint64_t>(t_Stages.ticks[stage] * nsPerTick) };
+				RecordZone(STAGE_NAMES[stage], start, end);
+				start = end;
+			}
+		}
+
+		void Clear()
+		{
+			const std::lock_guard lock{ g_BuffersMutex };
+			for (const auto& pBuffer : g_Buffers)
+				pBuffer->zoneCount = 0;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//Scoped timing zones for the hot paths, written out as a Chrome trace (chrome://tracing or ui.perfetto.dev)
+//Only compiled in with DAE_PROFILING=1 (CMake option RAYTRACER_PROFILING), otherwise the DAE_PROFILE_ macros expand to nothing.
+#ifndef DAE_PROFILING
+#define DAE_PROFILING 0
+#endif
+
+namespace dae
+{
+	namespace Profiler
+	{
+		constexpr bool IS_ENABLED{ DAE_PROFILING != 0 };
+
+		//Stages of a tile, these run once per ray or packet so they get accumulated instead of a zone each
+		enum class Stage
+		{
+			GenerateRays,
+			ClosestHit,
+			ShadowRays,
+			Shade,
+			//Keep last
+			Count
+		};
+
+		//Zones kept per thread, once a thread's ring buffer is full its oldest zones get overwritten
+		constexpr uint32_t RING_BUFFER_SIZE{ 1u << 18 };
+
+		//ns on the steady clock
+		inline uint64_t GetTimestamp()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		//Lock free, every thread records into its own ring buffer
+		//The name is stored as a pointer, so it has to be a string literal
+		void RecordZone(const char* name, uint64_t start, uint64_t end);
+
+		//Read and reset the ring buffers of all threads
+		//Only call these while no other thread records zones, e.g. between frames
+		bool WriteChromeTrace(const std::string& filePath);
+		void Clear();
+
+		//Starts splitting the calling thread's time into stages
+		void BeginStages();
+		//Adds the time since the last EndStage (or BeginStages) to the stage, costs a tick counter read
+		void EndStage(Stage stage);
+		//Only times the following stages if isSampled, for per pixel loops where a tick counter read costs about as much as a stage
+		//The stages get their share of the whole scope either way, so sampling every few pixels keeps the split
+		void SampleStages(bool isSampled);
+		//Records one zone per stage that got time, back to back from where BeginStages was called
+		void RecordStages();
+
+		class ScopedZone final
+		{
+		public:
+			explicit ScopedZone(const char* name) :
+				m_Name(name),
+				m_Start(GetTimestamp())
+			{
+			}
+			~ScopedZone()
+			{
+				RecordZone(m_Name, m_Start, GetTimestamp());
+			}
+
+			ScopedZone(const ScopedZone&) = delete;
+			ScopedZone(ScopedZone&&) noexcept = delete;
+			ScopedZone& operator=(const ScopedZone&) = delete;
+			ScopedZone& operator=(ScopedZone&&) noexcept = delete;
+
+		private:
+			const char* m_Name;
+			uint64_t m_Start;
+		};
+
+		class ScopedStages final
+		{
+		public:
+			ScopedStages()
+			{
+				BeginStages();
+			}
+			~ScopedStages()
+			{
+				RecordStages();
+			}
+
+			ScopedStages(const ScopedStages&) = delete;
+			ScopedStages(ScopedStages&&) noexcept = delete;
+			ScopedStages& operator=(const ScopedStages&) = delete;
+			ScopedStages& operator=(ScopedStages&&) noexcept = delete;
+		};
+	}
+}
+
+//DAE_PROFILE_ZONE times the rest of the enclosing scope
+//DAE_PROFILE_STAGES splits the rest of the enclosing scope into the stages ended with DAE_PROFILE_STAGE_END
+#if DAE_PROFILING
+#define DAE_PROFILE_CONCAT_INNER(a, b) a##b
+#define DAE_PROFILE_CONCAT(a, b) DAE_PROFILE_CONCAT_INNER(a, b)
+#define DAE_PROFILE_ZONE(name) const dae::Profiler::ScopedZone DAE_PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define DAE_PROFILE_STAGES() const dae::Profiler::ScopedStages DAE_PROFILE_CONCAT(profileStages, __LINE__){}
+#define DAE_PROFILE_STAGE_END(stage) dae::Profiler::EndStage(dae::Profiler::Stage::stage)
+#define DAE_PROFILE_SAMPLE_STAGES(isSampled) dae::Profiler::SampleStages(isSampled)
+#else
+#define DAE_PROFILE_ZONE(name) ((void)0)
+#define DAE_PROFILE_STAGES() ((void)0)
+#define DAE_PROFILE_STAGE_END(stage) ((void)0)
+#define DAE_PROFILE_SAMPLE_STAGES(isSampled) ((void)0)
+#endif
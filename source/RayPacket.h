@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Bundle of rays sharing one origin (e.g. a 2x2 or 4x4 block of primary rays)
+	//Every component is its own array so a loop over the lanes compiles to vector instructions.
+	//Lanes that don't carry a ray (e.g. past the edge of the screen) are cleared in activeMask.
+	template<int Lanes>
+	struct RayPacket
+	{
+		static_assert(Lanes > 0 && Lanes <= 32, "The lane masks are 32 bit");
+		static constexpr int LANES{ Lanes };
+
+		Vector3 origin{};
+		alignas(64) float directionX[Lanes]{};
+		alignas(64) float directionY[Lanes]{};
+		alignas(64) float directionZ[Lanes]{};
+
+		float min{ 0.0001f };
+		float max{ FLT_MAX };
+
+		uint32_t activeMask{};
+
+		Ray GetRay(int lane) const
+		{
+			return Ray{ origin, { directionX[lane], directionY[lane], directionZ[lane] }, min, max };
+		}
+
+		void SetDirection(int lane, const Vector3& direction)
+		{
+			directionX[lane] = direction.x;
+			directionY[lane] = direction.y;
+			directionZ[lane] = direction.z;
+		}
+
+		//Coherent packets agree on the direction sign of every axis, so they walk a BVH in the same order
+		bool IsCoherent() const
+		{
+			uint32_t positiveX{}, positiveY{}, positiveZ{};
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				positiveX |= uint32_t(directionX[lane] >= 0.f) << lane;
+				positiveY |= uint32_t(directionY[lane] >= 0.f) << lane;
+				positiveZ |= uint32_t(directionZ[lane] >= 0.f) << lane;
+			}
+
+			const auto agrees = [this](uint32_t positive) { return (positive & activeMask) == 0 || (positive & activeMask) == activeMask; };
+			return agrees(positiveX) && agrees(positiveY) && agrees(positiveZ);
+		}
+	};
+
+	template<int Lanes>
+	struct PacketHitRecord
+	{
+		PacketHitRecord()
+		{
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				t[lane] = FLT_MAX;
+			}
+		}
+
+		alignas(64) float originX[Lanes]{};
+		alignas(64) float originY[Lanes]{};
+		alignas(64) float originZ[Lanes]{};
+		alignas(64) float normalX[Lanes]{};
+		alignas(64) float normalY[Lanes]{};
+		alignas(64) float normalZ[Lanes]{};
+		alignas(64) float t[Lanes];
+
+		unsigned char materialIndex[Lanes]{};
+		uint32_t hitMask{};
+
+		HitRecord GetHitRecord(int lane) const
+		{
+			HitRecord hitRecord{};
+			hitRecord.origin = { originX[lane], originY[lane], originZ[lane] };
+			hitRecord.normal = { normalX[lane], normalY[lane], normalZ[lane] };
+			hitRecord.t = t[lane];
+			hitRecord.didHit = (hitMask >> lane) & 1;
+			hitRecord.materialIndex = materialIndex[lane];
+			return hitRecord;
+		}
+
+		void SetHitRecord(int lane, const HitRecord& hitRecord)
+		{
+			originX[lane] = hitRecord.origin.x;
+			originY[lane] = hitRecord.origin.y;
+			originZ[lane] = hitRecord.origin.z;
+			normalX[lane] = hitRecord.normal.x;
+			normalY[lane] = hitRecord.normal.y;
+			normalZ[lane] = hitRecord.normal.z;
+			t[lane] = hitRecord.t;
+			materialIndex[lane] = hitRecord.materialIndex;
+			hitMask = (hitMask & ~(1u << lane)) | (uint32_t(hitRecord.didHit) << lane);
+		}
+	};
+}
@@ -0,0 +1,91 @@
+#include "RayStats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		std::mutex g_CountersMutex{};
+		std::vector<RayCounters*> g_ThreadCounters{};
+		//Counted by threads that have finished since the last Collect, e.g. std::async render threads
+		RayCounters g_FinishedCounters{};
+
+		class ThreadCountersHandle final
+		{
+		public:
+			ThreadCountersHandle()
+			{
+				const std::lock_guard lock{ g_CountersMutex };
+				g_ThreadCounters.push_back(&m_Counters);
+			}
+			~ThreadCountersHandle()
+			{
+				const std::lock_guard lock{ g_CountersMutex };
+				g_FinishedCounters += m_Counters;
+				g_ThreadCounters.erase(std::find(g_ThreadCounters.begin(), g_ThreadCounters.end(), &m_Counters));
+			}
+
+			ThreadCountersHandle(const ThreadCountersHandle&) = delete;
+			ThreadCountersHandle(ThreadCountersHandle&&) noexcept = delete;
+			ThreadCountersHandle& operator=(const ThreadCountersHandle&) = delete;
+			ThreadCountersHandle& operator=(ThreadCountersHandle&&) noexcept = delete;
+
+			RayCounters& Get() { return m_Counters; }
+
+		private:
+			RayCounters m_Counters{};
+		};
+
+		thread_local ThreadCountersHandle t_Counters{};
+	}
+
+	const char* RayCounters::GetName(RayCounter counter)
+	{
+		switch (counter)
+		{
+		case RayCounter::PrimaryRays:
+			return "primaryRays";
+		case RayCounter::PrimaryHits:
+			return "primaryHits";
+		case RayCounter::ShadowRays:
+			return "shadowRays";
+		case RayCounter::ShadowHits:
+			return "shadowHits";
+		case RayCounter::NodeVisits:
+			return "nodeVisits";
+		case RayCounter::SphereTests:
+			return "sphereTests";
+		case RayCounter::PlaneTests:
+			return "planeTests";
+		case RayCounter::TriangleTests:
+			return "triangleTests";
+		default:
+			return "unknown";
+		}
+	}
+
+	namespace RayStats
+	{
+		RayCounters& GetThreadCounters()
+		{
+			return t_Counters.Get();
+		}
+
+		RayCounters Collect()
+		{
+			const std::lock_guard lock{ g_CountersMutex };
+
+			RayCounters total{ g_FinishedCounters };
+			g_FinishedCounters = {};
+			for (RayCounters* pCounters : g_ThreadCounters)
+			{
+				total += *pCounters;
+				*pCounters = {};
+			}
+			return total;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+//Ray and intersection counters, for judging how well the acceleration structures cull
+//Only compiled in with DAE_RAY_STATS=1 (CMake option RAYTRACER_RAY_STATS), otherwise DAE_COUNT_RAYS expands to nothing.
+#ifndef DAE_RAY_STATS
+#define DAE_RAY_STATS 0
+#endif
+
+namespace dae
+{
+	//Tests and node visits are counted per ray, a packet adds one for every active lane
+	enum class RayCounter
+	{
+		PrimaryRays,
+		PrimaryHits,
+		ShadowRays,
+		ShadowHits, //occluded
+		NodeVisits,
+		SphereTests,
+		PlaneTests,
+		TriangleTests,
+		//Keep last
+		Count
+	};
+
+	struct RayCounters
+	{
+		uint64_t values[static_cast<int>(RayCounter::Count)]{};
+
+		uint64_t Get(RayCounter counter) const { return values[static_cast<int>(counter)]; }
+
+		RayCounters& operator+=(const RayCounters& other)
+		{
+			for (int index{}; index < static_cast<int>(RayCounter::Count); ++index)
+				values[index] += other.values[index];
+			return *this;
+		}
+
+		static const char* GetName(RayCounter counter);
+	};
+
+	namespace RayStats
+	{
+		constexpr bool IS_ENABLED{ DAE_RAY_STATS != 0 };
+
+		//The calling thread's counters, every thread has its own so counting needs no atomics
+		RayCounters& GetThreadCounters();
+
+		inline void Add(RayCounter counter, uint64_t amount)
+		{
+			GetThreadCounters().values[static_cast<int>(counter)] += amount;
+		}
+
+		//Sums the counters of all threads (finished ones included) and resets them
+		//Only call this while no other thread counts, e.g. after a frame's ParallelFor
+		RayCounters Collect();
+	}
+}
+
+#if DAE_RAY_STATS
+#define DAE_COUNT_RAYS(counter, amount) dae::RayStats::Add(dae::RayCounter::counter, amount)
+#else
+#define DAE_COUNT_RAYS(counter, amount) ((void)0)
+#endif
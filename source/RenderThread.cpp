@@ -0,0 +1,60 @@
+#include "RenderThread.h"
+
+#include "Profiler.h"
+#include "Renderer.h"
+
+using namespace dae;
+
+RenderThread::RenderThread(Renderer* pRenderer) :
+	m_pRenderer(pRenderer),
+	m_Thread(&RenderThread::Loop, this)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsShuttingDown = true;
+	}
+	m_Condition.notify_all();
+
+	m_Thread.join();
+}
+
+void RenderThread::Start(Scene* pScene)
+{
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_Condition.wait(lock, [this] { return m_pScene == nullptr; });
+		m_pScene = pScene;
+	}
+	m_Condition.notify_all();
+}
+
+void RenderThread::Wait()
+{
+	DAE_PROFILE_ZONE("RenderThread::Wait");
+	std::unique_lock lock{ m_Mutex };
+	m_Condition.wait(lock, [this] { return m_pScene == nullptr; });
+}
+
+void RenderThread::Loop()
+{
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		m_Condition.wait(lock, [this] { return m_pScene || m_IsShuttingDown; });
+		if (!m_pScene)
+			return;
+
+		//Render outside the lock, Start and Wait only need it to hand over and check m_pScene
+		Scene* pScene{ m_pScene };
+		lock.unlock();
+		m_pRenderer->Render(pScene);
+		lock.lock();
+
+		m_pScene = nullptr;
+		m_Condition.notify_all();
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+
+	//One persistent thread that runs Renderer::Render, so the caller can present the front buffer while the back buffer traces
+	//Frames are handed over one at a time: Start returns right away, Wait blocks until that frame is in the front buffer.
+	class RenderThread final
+	{
+	public:
+		explicit RenderThread(Renderer* pRenderer);
+		//Finishes a frame that is still running
+		~RenderThread();
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread(RenderThread&&) noexcept = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+		RenderThread& operator=(RenderThread&&) noexcept = delete;
+
+		//Waits for the previous frame first if it is still running
+		void Start(Scene* pScene);
+		void Wait();
+
+	private:
+		void Loop();
+
+		Renderer* m_pRenderer{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		//Frame to render, null once it is done
+		Scene* m_pScene{};
+		bool m_IsShuttingDown{ false };
+
+		//Last, so everything above exists before Loop runs
+		std::thread m_Thread{};
+	};
+}
@@ -1,82 +1,1136 @@
-//External includes
-#include "SDL.h"
-#include "SDL_surface.h"
+//Standard includes
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 
 //Project includes
 #include "Renderer.h"
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "Profiler.h"
+#include "RayPacket.h"
+#include "RayStats.h"
 #include "Scene.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window * pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+namespace
+{
+	//Offset inside the pixel, in [0, 1), of progressive sample sampleIndex
+	//Sample 0 goes through the center like the regular mode does, the others follow the R2 low discrepancy sequence
+	//rotated by a hash of the pixel, so neighbouring pixels don't sample the same pattern
+	void GetSampleOffset(int px, int py, uint32_t sampleIndex, float& offsetX, float& offsetY)
+	{
+		if (sampleIndex == 0)
+		{
+			offsetX = 0.5f;
+			offsetY = 0.5f;
+			return;
+		}
+
+		uint32_t hash{ uint32_t(px) * 0x8DA6B343u ^ uint32_t(py) * 0xD8163841u };
+		hash ^= hash >> 16;
+		hash *= 0x7FEB352Du;
+		hash ^= hash >> 15;
+
+		constexpr float R2_X{ 0.7548776662f };
+		constexpr float R2_Y{ 0.5698402910f };
+		offsetX = (hash & 0xFFFF) / 65536.f + sampleIndex * R2_X;
+		offsetY = (hash >> 16) / 65536.f + sampleIndex * R2_Y;
+		offsetX -= std::floor(offsetX);
+		offsetY -= std::floor(offsetY);
+	}
+
+	//8 rooks pattern (the common 8x MSAA one), every row and column of an 8x8 grid over the pixel holds one sample
+	constexpr float ANTI_ALIASING_OFFSETS[8][2]
+	{
+		{ 0.5625f, 0.3125f }, { 0.4375f, 0.6875f }, { 0.8125f, 0.5625f }, { 0.3125f, 0.1875f },
+		{ 0.1875f, 0.8125f }, { 0.0625f, 0.4375f }, { 0.6875f, 0.9375f }, { 0.9375f, 0.0625f }
+	};
+
+	float GetLuminance(const ColorRGB& color)
+	{
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
+
+	//The calling thread's occlusion caches, one per light, emptied for the tile that is about to start
+	//A cache keeps its occluder through misses, so one carried over from another part of the image
+	//costs a wasted test (a whole mesh for instances) on every shadow ray of an unoccluded tile
+	OcclusionCache* GetTileOcclusionCaches(size_t numLights)
+	{
+		thread_local std::vector<OcclusionCache> t_OcclusionCaches{};
+		if (t_OcclusionCaches.size() < numLights)
+			t_OcclusionCaches.resize(numLights);
+		std::fill_n(t_OcclusionCaches.begin(), numLights, OcclusionCache{});
+		return t_OcclusionCaches.data();
+	}
+}
+
+Renderer::Renderer(int width, int height) :
+	m_FrameBuffers{ { std::vector<ColorRGB>(size_t(width) * height), width, height }, { std::vector<ColorRGB>(size_t(width) * height), width, height } },
+	m_OutputWidth(width),
+	m_OutputHeight(height),
+	m_Width(width),
+	m_Height(height),
+	m_pThreadPool(std::make_unique<ThreadPool>())
 {
-	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 }
 
-void Renderer::Render(Scene* pScene) const
+Renderer::~Renderer() = default;
+
+struct Renderer::FrameContext
 {
+	const Scene* pScene{};
+	const MaterialPool* pMaterials{};
+	const std::vector<Light>* pLights{};
+	ColorRGB* pFrameBuffer{};
+	AccumulatedPixel* pAccumulatedPixels{};
+	std::atomic<uint32_t>* pConvergedPixelCount{};
+	std::atomic<uint64_t>* pPrimaryRayCount{};
+	EdgeSample* pEdgeSamples{};
+	std::atomic<uint32_t>* pAntiAliasedPixelCount{};
+	WavefrontQueues* pWavefrontQueues{};
+	Matrix cameraToWorld{};
+	Vector3 cameraOrigin{};
+	//For rays that don't go through the pixel center
+	float fov{};
+	float aspectRatio{};
+};
+
+void Renderer::Render(Scene* pScene)
+{
+	DAE_PROFILE_ZONE("Renderer::Render");
+	const auto renderStart = std::chrono::steady_clock::now();
+
 	Camera& camera = pScene->GetCamera();
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
 
-	float ascpectRatio{ float(m_Width) / m_Height };
+	m_Width = std::max(static_cast<int>(m_OutputWidth * m_ResolutionScale + 0.5f), 1);
+	m_Height = std::max(static_cast<int>(m_OutputHeight * m_ResolutionScale + 0.5f), 1);
+
+	UpdateDirectionTables(camera.fovAngle);
+
+	FrameContext context{};
+	context.pScene = pScene;
+	context.pMaterials = &pScene->GetMaterials();
+	context.pLights = &pScene->GetLights();
+	//Only Render writes the front buffer index, so it can't change under us
+	const uint32_t backBuffer{ 1 - m_FrontBuffer.load(std::memory_order_relaxed) };
+	FrameBuffer& frameBuffer{ m_FrameBuffers[backBuffer] };
+	frameBuffer.pixels.resize(size_t(m_Width) * m_Height);
+	frameBuffer.width = m_Width;
+	frameBuffer.height = m_Height;
+	context.pFrameBuffer = frameBuffer.pixels.data();
+	m_PrimaryRayCount = 0;
+	context.pPrimaryRayCount = &m_PrimaryRayCount;
+	context.cameraToWorld = camera.CalculateCameraToWorld();
+	context.cameraOrigin = camera.origin;
+	context.fov = tanf(camera.fovAngle * TO_RADIANS / 2.f);
+	context.aspectRatio = float(m_Width) / m_Height;
+
+	if (m_IsProgressive)
+	{
+		const bool hasChanged{ !(context.cameraToWorld == m_AccumulatedCameraToWorld)
+			|| camera.fovAngle != m_AccumulatedFov
+			|| pScene->GetVersion() != m_AccumulatedSceneVersion };
+		if (hasChanged || m_AccumulatedPixels.size() != size_t(m_Width) * m_Height)
+		{
+			m_AccumulatedPixels.assign(size_t(m_Width) * m_Height, AccumulatedPixel{});
+			m_AccumulatedCameraToWorld = context.cameraToWorld;
+			m_AccumulatedFov = camera.fovAngle;
+			m_AccumulatedSceneVersion = pScene->GetVersion();
+			m_AccumulatedFrames = 0;
+		}
+		m_ConvergedPixelCount = 0;
+
+		context.pAccumulatedPixels = m_AccumulatedPixels.data();
+		context.pConvergedPixelCount = &m_ConvergedPixelCount;
+	}
+	else if (m_IsAdaptiveAntiAliasing)
+	{
+		m_EdgeSamples.resize(size_t(m_Width) * m_Height);
+		m_AntiAliasedPixelCount = 0;
+
+		context.pEdgeSamples = m_EdgeSamples.data();
+		context.pAntiAliasedPixelCount = &m_AntiAliasedPixelCount;
+	}
+
+	//Every pixel only depends on its own coordinates, so the tile order doesn't change the image
+	const int numTilesX{ (m_Width + TILE_SIZE - 1) / TILE_SIZE };
+	const int numTilesY{ (m_Height + TILE_SIZE - 1) / TILE_SIZE };
+
+	if (m_IsWavefront && !m_IsProgressive)
+	{
+		context.pWavefrontQueues = &m_WavefrontQueues;
+		RenderWavefront(context, static_cast<uint32_t>(numTilesX * numTilesY));
+	}
+	else
+	{
+		m_pThreadPool->ParallelFor(static_cast<uint32_t>(numTilesX * numTilesY), [&](uint32_t tileIndex)
+			{
+				RenderTile(context, static_cast<int>(tileIndex));
+			});
+	}
+
+	if (context.pEdgeSamples)
+	{
+		m_pThreadPool->ParallelFor(static_cast<uint32_t>(numTilesX * numTilesY), [&](uint32_t tileIndex)
+			{
+				AntiAliasTile(context, static_cast<int>(tileIndex));
+			});
+	}
+
+	//Both counts of this frame in one store, the main thread reads them while the next frame runs (and maybe resizes)
+	const uint64_t numAntiAliased{ context.pEdgeSamples ? m_AntiAliasedPixelCount.load(std::memory_order_relaxed) : 0u };
+	m_AntiAliasedFrameCounts.store(numAntiAliased << 32 | uint32_t(m_Width * m_Height), std::memory_order_relaxed);
+
+	//Same for the progressive counts, Render zeroes the converged count and may resize the accumulated pixels
+	if (m_IsProgressive)
+	{
+		++m_AccumulatedFrames;
+		const float convergedFraction{ float(m_ConvergedPixelCount.load(std::memory_order_relaxed)) / m_AccumulatedPixels.size() };
+		m_ProgressiveFrameStats.store(uint64_t(m_AccumulatedFrames) << 32 | std::bit_cast<uint32_t>(convergedFraction), std::memory_order_relaxed);
+	}
+
+	//The pool is idle again, so every worker's counters can be read
+	if constexpr (RayStats::IS_ENABLED)
+		m_RayCounters = RayStats::Collect();
+
+	//Publish the finished frame, readers that load the index after this see all of its pixels
+	m_FrontBuffer.store(backBuffer, std::memory_order_release);
+
+	if (m_TargetFrameTime > 0.f)
+		UpdateResolutionScale(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - renderStart).count());
+}
+
+void Renderer::UpdateResolutionScale(float frameTime)
+{
+	//Frame time goes with the pixel count, i.e. the square of the scale
+	//Only go halfway to the ideal scale per frame, so a single slow frame doesn't make the resolution jump
+	const float idealScale{ m_ResolutionScale * std::sqrt(m_TargetFrameTime / std::max(frameTime, 0.001f)) };
+	const float scale{ std::clamp(m_ResolutionScale + (idealScale - m_ResolutionScale) * 0.5f, MIN_RESOLUTION_SCALE, 1.f) };
 
-	Vector3 direction{};
-	Ray ray{ {0,0,0}, direction };
+	if (std::abs(scale - m_ResolutionScale) >= RESOLUTION_SCALE_STEP || scale == 1.f || scale == MIN_RESOLUTION_SCALE)
+		m_ResolutionScale = scale;
+}
 
-	float z{ 1.f };
-	//Sphere sphere{ Vector3{0,0,100}, 50, 0 };
+void Renderer::UpdateDirectionTables(float fovAngle)
+{
+	if (fovAngle == m_DirectionTablesFov
+		&& m_ColumnDirections.size() == static_cast<size_t>(m_Width)
+		&& m_RowDirections.size() == static_cast<size_t>(m_Height))
+		return;
 
+	const float fov{ tanf(fovAngle * TO_RADIANS / 2.f) };
+	const float aspectRatio{ float(m_Width) / m_Height };
 
+	m_ColumnDirections.resize(m_Width);
 	for (int px{}; px < m_Width; ++px)
 	{
-		float x{ (2 * (px + 0.5f) / m_Width - 1) * ascpectRatio };
+		m_ColumnDirections[px] = (2 * (px + 0.5f) / m_Width - 1) * aspectRatio * fov;
+	}
+
+	m_RowDirections.resize(m_Height);
+	for (int py{}; py < m_Height; ++py)
+	{
+		m_RowDirections[py] = (1 - 2 * (py + 0.5f) / m_Height) * fov;
+	}
+
+	m_DirectionTablesFov = fovAngle;
+}
+
+void Renderer::GetTileBounds(int tileIndex, int& startX, int& startY, int& endX, int& endY) const
+{
+	const int numTilesX{ (m_Width + TILE_SIZE - 1) / TILE_SIZE };
+
+	startX = (tileIndex % numTilesX) * TILE_SIZE;
+	startY = (tileIndex / numTilesX) * TILE_SIZE;
+	endX = std::min(startX + TILE_SIZE, m_Width);
+	endY = std::min(startY + TILE_SIZE, m_Height);
+}
+
+void Renderer::RenderTile(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Renderer::RenderTile");
+	DAE_PROFILE_STAGES();
+	int startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+
+	OcclusionCache* pOcclusionCaches{ GetTileOcclusionCaches(context.pLights->size()) };
+
+	if (context.pAccumulatedPixels)
+	{
+		RenderTileProgressive(context, pOcclusionCaches, startX, startY, endX, endY);
+		return;
+	}
+
+	context.pPrimaryRayCount->fetch_add(uint64_t(endX - startX) * (endY - startY), std::memory_order_relaxed);
+	DAE_COUNT_RAYS(PrimaryRays, uint64_t(endX - startX) * (endY - startY));
+
+	switch (m_PacketSize)
+	{
+	case 2:
+		RenderTilePackets<2>(context, pOcclusionCaches, startX, startY, endX, endY);
+		break;
+	case 4:
+		RenderTilePackets<4>(context, pOcclusionCaches, startX, startY, endX, endY);
+		break;
+	default:
+		RenderTileRays(context, pOcclusionCaches, startX, startY, endX, endY);
+		break;
+	}
+}
+
+void Renderer::RenderTileRays(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const
+{
+	Ray ray{ context.cameraOrigin, {} };
+
+	//Row-major, so consecutive pixels land next to each other in the buffer
+	for (int py{ startY }; py < endY; ++py)
+	{
+		const float y{ m_RowDirections[py] };
 
-		for (int py{}; py < m_Height; ++py)
+		for (int px{ startX }; px < endX; ++px)
 		{
-	
-			float y{ 1 - 2 * (py + 0.5f) / m_Height };
-			
-			direction.x = x;
-			direction.y = y;
-			direction.z = z;
-			direction.Normalize();
+			//Timing every pixel would cost about as much as tracing it
+			DAE_PROFILE_SAMPLE_STAGES(px % 8 == 0);
+			ray.direction = context.cameraToWorld.TransformVector(m_ColumnDirections[px], y, 1.f);
+			ray.direction.Normalize();
+			DAE_PROFILE_STAGE_END(GenerateRays);
 
-			ray.direction = direction;
-			ColorRGB finalColor{ };
 			HitRecord closestHit{};
-			//GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
-			pScene->GetClosestHit(ray, closestHit);
-			if (closestHit.didHit)
+			context.pScene->GetClosestHit(ray, closestHit);
+			DAE_PROFILE_STAGE_END(ClosestHit);
+
+			WritePixel(context, px, py, ShadePixel(context, ray.direction, closestHit, pOcclusionCaches), closestHit);
+			DAE_PROFILE_STAGE_END(Shade);
+		}
+	}
+}
+
+void Renderer::AntiAliasTile(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Renderer::AntiAliasTile");
+	DAE_PROFILE_STAGES();
+	int startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+
+	OcclusionCache* pOcclusionCaches{ GetTileOcclusionCaches(context.pLights->size()) };
+	uint32_t numAntiAliased{};
+
+	//The samples of one pixel are about as coherent as rays get, so they go in 2x2 packets
+	constexpr int lanes{ 4 };
+	static_assert(std::size(ANTI_ALIASING_OFFSETS) % lanes == 0);
+
+	//Only reads the edge samples and only writes the frame buffer, so tiles can't see each other's results
+	for (int py{ startY }; py < endY; ++py)
+	{
+		for (int px{ startX }; px < endX; ++px)
+		{
+			const EdgeSample& center{ context.pEdgeSamples[px + (py * m_Width)] };
+			const auto differs = [&](int neighbourX, int neighbourY)
+				{
+					if (neighbourX < 0 || neighbourY < 0 || neighbourX >= m_Width || neighbourY >= m_Height)
+						return false;
+
+					const EdgeSample& neighbour{ context.pEdgeSamples[neighbourX + (neighbourY * m_Width)] };
+					return neighbour.key != center.key || std::abs(neighbour.luminance - center.luminance) > m_AntiAliasingThreshold;
+				};
+
+			if (!differs(px - 1, py) && !differs(px + 1, py) && !differs(px, py - 1) && !differs(px, py + 1))
+				continue;
+
+			ColorRGB finalColor{};
+			for (size_t firstSample{}; firstSample < std::size(ANTI_ALIASING_OFFSETS); firstSample += lanes)
+			{
+				RayPacket<lanes> packet{};
+				packet.origin = context.cameraOrigin;
+				packet.activeMask = (1u << lanes) - 1;
+				for (int lane{}; lane < lanes; ++lane)
+				{
+					const auto& offset{ ANTI_ALIASING_OFFSETS[firstSample + lane] };
+					packet.SetDirection(lane, GetRayDirection(context, px + offset[0], py + offset[1]));
+				}
+				DAE_PROFILE_STAGE_END(GenerateRays);
+
+				PacketHitRecord<lanes> closestHits{};
+				context.pScene->GetClosestHit(packet, closestHits);
+				DAE_PROFILE_STAGE_END(ClosestHit);
+
+				ColorRGB colors[lanes]{};
+				ShadePacket(context, packet, closestHits, colors, pOcclusionCaches);
+				for (const ColorRGB& color : colors)
+				{
+					finalColor += color;
+				}
+				DAE_PROFILE_STAGE_END(Shade);
+			}
+			context.pFrameBuffer[px + (py * m_Width)] = finalColor * (1.f / std::size(ANTI_ALIASING_OFFSETS));
+			++numAntiAliased;
+		}
+	}
+
+	context.pAntiAliasedPixelCount->fetch_add(numAntiAliased, std::memory_order_relaxed);
+	context.pPrimaryRayCount->fetch_add(uint64_t(numAntiAliased) * std::size(ANTI_ALIASING_OFFSETS), std::memory_order_relaxed);
+	DAE_COUNT_RAYS(PrimaryRays, uint64_t(numAntiAliased) * std::size(ANTI_ALIASING_OFFSETS));
+}
+
+void Renderer::RenderTileProgressive(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const
+{
+	Ray ray{ context.cameraOrigin, {} };
+	uint32_t numConverged{};
+	uint64_t numRays{};
+
+	for (int py{ startY }; py < endY; ++py)
+	{
+		for (int px{ startX }; px < endX; ++px)
+		{
+			DAE_PROFILE_SAMPLE_STAGES(px % 8 == 0);
+			AccumulatedPixel& pixel{ context.pAccumulatedPixels[px + (py * m_Width)] };
+
+			if (!pixel.isConverged)
+			{
+				float offsetX{}, offsetY{};
+				GetSampleOffset(px, py, pixel.sampleCount, offsetX, offsetY);
+
+				ray.direction = GetRayDirection(context, px + offsetX, py + offsetY);
+				DAE_PROFILE_STAGE_END(GenerateRays);
+
+				HitRecord closestHit{};
+				context.pScene->GetClosestHit(ray, closestHit);
+				DAE_PROFILE_STAGE_END(ClosestHit);
+				++numRays;
+				const ColorRGB sample{ ShadePixel(context, ray.direction, closestHit, pOcclusionCaches) };
+
+				pixel.colorSum += sample;
+				++pixel.sampleCount;
+
+				const float luminance{ GetLuminance(sample) };
+				const float delta{ luminance - pixel.luminanceMean };
+				pixel.luminanceMean += delta / pixel.sampleCount;
+				pixel.luminanceM2 += delta * (luminance - pixel.luminanceMean);
+
+				if (pixel.sampleCount >= MAX_PROGRESSIVE_SAMPLES)
+				{
+					pixel.isConverged = true;
+				}
+				else if (pixel.sampleCount >= MIN_CONVERGENCE_SAMPLES)
+				{
+					//Variance of the mean = sample variance / n
+					const float meanVariance{ pixel.luminanceM2 / ((pixel.sampleCount - 1) * float(pixel.sampleCount)) };
+					const float tolerance{ m_ConvergenceThreshold * std::max(pixel.luminanceMean, MIN_CONVERGENCE_LUMINANCE) };
+					pixel.isConverged = meanVariance <= tolerance * tolerance;
+				}
+			}
+
+			numConverged += pixel.isConverged;
+
+			const float inverseCount{ 1.f / pixel.sampleCount };
+			WritePixel(context, px, py, { pixel.colorSum.r * inverseCount, pixel.colorSum.g * inverseCount, pixel.colorSum.b * inverseCount }, {});
+			DAE_PROFILE_STAGE_END(Shade);
+		}
+	}
+
+	context.pConvergedPixelCount->fetch_add(numConverged, std::memory_order_relaxed);
+	context.pPrimaryRayCount->fetch_add(numRays, std::memory_order_relaxed);
+	DAE_COUNT_RAYS(PrimaryRays, numRays);
+}
+
+template<int PacketSize>
+void Renderer::RenderTilePackets(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const
+{
+	constexpr int lanes{ PacketSize * PacketSize };
+
+	for (int packetY{ startY }; packetY < endY; packetY += PacketSize)
+	{
+		for (int packetX{ startX }; packetX < endX; packetX += PacketSize)
+		{
+			//Lane = row * PacketSize + column, lanes outside the tile stay inactive
+			RayPacket<lanes> packet{};
+			packet.origin = context.cameraOrigin;
+			for (int lane{}; lane < lanes; ++lane)
+			{
+				const int px{ packetX + lane % PacketSize };
+				const int py{ packetY + lane / PacketSize };
+				if (px >= endX || py >= endY)
+					continue;
+
+				Vector3 direction{ context.cameraToWorld.TransformVector(m_ColumnDirections[px], m_RowDirections[py], 1.f) };
+				direction.Normalize();
+
+				packet.SetDirection(lane, direction);
+				packet.activeMask |= 1u << lane;
+			}
+			DAE_PROFILE_STAGE_END(GenerateRays);
+
+			PacketHitRecord<lanes> closestHits{};
+			context.pScene->GetClosestHit(packet, closestHits);
+			DAE_PROFILE_STAGE_END(ClosestHit);
+
+			ColorRGB colors[lanes]{};
+			ShadePacket(context, packet, closestHits, colors, pOcclusionCaches);
+
+			for (int lane{}; lane < lanes; ++lane)
+			{
+				if (!((packet.activeMask >> lane) & 1))
+					continue;
+
+				WritePixel(context, packetX + lane % PacketSize, packetY + lane / PacketSize, colors[lane], closestHits.GetHitRecord(lane));
+			}
+			DAE_PROFILE_STAGE_END(Shade);
+		}
+	}
+}
+
+HitRecord Renderer::WavefrontQueues::GetHit(size_t index) const
+{
+	HitRecord hitRecord{};
+	hitRecord.origin = { hitOriginX[index], hitOriginY[index], hitOriginZ[index] };
+	hitRecord.normal = { hitNormalX[index], hitNormalY[index], hitNormalZ[index] };
+	hitRecord.t = hitT[index];
+	hitRecord.didHit = didHit[index];
+	hitRecord.materialIndex = hitMaterialIndices[index];
+	return hitRecord;
+}
+
+void Renderer::WavefrontQueues::SetHit(size_t index, const HitRecord& hitRecord)
+{
+	hitOriginX[index] = hitRecord.origin.x;
+	hitOriginY[index] = hitRecord.origin.y;
+	hitOriginZ[index] = hitRecord.origin.z;
+	hitNormalX[index] = hitRecord.normal.x;
+	hitNormalY[index] = hitRecord.normal.y;
+	hitNormalZ[index] = hitRecord.normal.z;
+	hitT[index] = hitRecord.t;
+	didHit[index] = hitRecord.didHit;
+	hitMaterialIndices[index] = hitRecord.materialIndex;
+}
+
+void Renderer::RenderWavefront(const FrameContext& context, uint32_t numTiles)
+{
+	constexpr size_t tileRayCount{ TILE_SIZE * TILE_SIZE };
+	const size_t numRays{ numTiles * tileRayCount };
+	const size_t numShadowRays{ numRays * context.pLights->size() };
+
+	WavefrontQueues& queues{ m_WavefrontQueues };
+	for (std::vector<float>* pQueue : { &queues.directionX, &queues.directionY, &queues.directionZ,
+		&queues.hitOriginX, &queues.hitOriginY, &queues.hitOriginZ, &queues.hitNormalX, &queues.hitNormalY, &queues.hitNormalZ, &queues.hitT })
+	{
+		pQueue->resize(numRays);
+	}
+	queues.pixelIndices.resize(numRays);
+	queues.hitMaterialIndices.resize(numRays);
+	queues.didHit.resize(numRays);
+	queues.rayCounts.resize(numTiles);
+
+	for (std::vector<float>* pQueue : { &queues.shadowOriginX, &queues.shadowOriginY, &queues.shadowOriginZ,
+		&queues.shadowDirectionX, &queues.shadowDirectionY, &queues.shadowDirectionZ, &queues.shadowMax, &queues.observedAreas })
+	{
+		pQueue->resize(numShadowRays);
+	}
+	queues.shadowRayIndices.resize(numShadowRays);
+	queues.shadowLightIndices.resize(numShadowRays);
+	queues.isOccluded.resize(numShadowRays);
+	queues.shadowRayCounts.resize(numTiles);
+	queues.shadowLightBins.resize(numShadowRays);
+	queues.shadowLightBinStarts.resize(numTiles * (context.pLights->size() + 1));
+
+	queues.hitRecords.resize(numRays);
+	queues.colors.resize(numRays);
+	queues.shadowHitRecords.resize(numShadowRays);
+	queues.toLights.resize(numShadowRays);
+	queues.viewDirections.resize(numShadowRays);
+	queues.brdfs.resize(numShadowRays);
+	queues.binnedIndices.resize(numShadowRays);
+	queues.occlusionCaches.resize(numTiles * context.pLights->size());
+
+	//Every stage finishes the whole frame before the next one starts
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex) { GenerateWavefrontRays(context, static_cast<int>(tileIndex)); });
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex) { TraceWavefrontRays(context, static_cast<int>(tileIndex)); });
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex) { GenerateWavefrontShadowRays(context, static_cast<int>(tileIndex)); });
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex) { TraceWavefrontShadowRays(context, static_cast<int>(tileIndex)); });
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex) { ShadeWavefront(context, static_cast<int>(tileIndex)); });
+}
+
+void Renderer::GenerateWavefrontRays(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Wavefront::GenerateRays");
+
+	int startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+	const size_t first{ size_t(tileIndex) * TILE_SIZE * TILE_SIZE };
+	uint32_t count{};
+
+	//Block after block of packetSize x packetSize pixels, so consecutive rays make coherent packets for the closest hit stage
+	for (int packetY{ startY }; packetY < endY; packetY += m_PacketSize)
+	{
+		for (int packetX{ startX }; packetX < endX; packetX += m_PacketSize)
+		{
+			for (int py{ packetY }; py < std::min(packetY + m_PacketSize, endY); ++py)
+			{
+				for (int px{ packetX }; px < std::min(packetX + m_PacketSize, endX); ++px)
+				{
+					Vector3 direction{ context.cameraToWorld.TransformVector(m_ColumnDirections[px], m_RowDirections[py], 1.f) };
+					direction.Normalize();
+
+					queues.directionX[first + count] = direction.x;
+					queues.directionY[first + count] = direction.y;
+					queues.directionZ[first + count] = direction.z;
+					queues.pixelIndices[first + count] = static_cast<uint32_t>(px + (py * m_Width));
+					++count;
+				}
+			}
+		}
+	}
+	queues.rayCounts[tileIndex] = count;
+
+	context.pPrimaryRayCount->fetch_add(count, std::memory_order_relaxed);
+	DAE_COUNT_RAYS(PrimaryRays, count);
+}
+
+void Renderer::TraceWavefrontRays(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Wavefront::TraceRays");
+
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+	const uint32_t first{ static_cast<uint32_t>(tileIndex) * TILE_SIZE * TILE_SIZE };
+	const uint32_t count{ queues.rayCounts[tileIndex] };
+
+	switch (m_PacketSize)
+	{
+	case 2:
+		TraceWavefrontPackets<4>(context, first, count);
+		break;
+	case 4:
+		TraceWavefrontPackets<16>(context, first, count);
+		break;
+	default:
+	{
+		Ray ray{ context.cameraOrigin, {} };
+		for (uint32_t index{ first }; index < first + count; ++index)
+		{
+			ray.direction = { queues.directionX[index], queues.directionY[index], queues.directionZ[index] };
+
+			HitRecord closestHit{};
+			context.pScene->GetClosestHit(ray, closestHit);
+			queues.SetHit(index, closestHit);
+		}
+		break;
+	}
+	}
+}
+
+template<int Lanes>
+void Renderer::TraceWavefrontPackets(const FrameContext& context, uint32_t first, uint32_t count) const
+{
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+
+	for (uint32_t packetFirst{ first }; packetFirst < first + count; packetFirst += Lanes)
+	{
+		const int numLanes{ static_cast<int>(std::min(uint32_t(Lanes), first + count - packetFirst)) };
+
+		RayPacket<Lanes> packet{};
+		packet.origin = context.cameraOrigin;
+		for (int lane{}; lane < numLanes; ++lane)
+		{
+			const uint32_t index{ packetFirst + lane };
+			packet.SetDirection(lane, { queues.directionX[index], queues.directionY[index], queues.directionZ[index] });
+			packet.activeMask |= 1u << lane;
+		}
+
+		PacketHitRecord<Lanes> closestHits{};
+		context.pScene->GetClosestHit(packet, closestHits);
+
+		for (int lane{}; lane < numLanes; ++lane)
+		{
+			queues.SetHit(packetFirst + lane, closestHits.GetHitRecord(lane));
+		}
+	}
+}
+
+void Renderer::GenerateWavefrontShadowRays(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Wavefront::GenerateShadowRays");
+
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+	const auto& lights = *context.pLights;
+	const size_t first{ size_t(tileIndex) * TILE_SIZE * TILE_SIZE };
+	const size_t shadowFirst{ first * lights.size() };
+	uint32_t shadowCount{};
+
+	//Bin l + 1 counts light l's rays first
+	uint32_t* binStarts{ queues.shadowLightBinStarts.data() + size_t(tileIndex) * (lights.size() + 1) };
+	std::fill(binStarts, binStarts + lights.size() + 1, 0u);
+
+	for (uint32_t rayIndex{}; rayIndex < queues.rayCounts[tileIndex]; ++rayIndex)
+	{
+		if (!queues.didHit[first + rayIndex])
+			continue;
+
+		const HitRecord closestHit{ queues.GetHit(first + rayIndex) };
+		const Vector3 shadowOrigin{ closestHit.origin + closestHit.normal * SHADOW_RAY_OFFSET };
+
+		for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+		{
+			const Light& light{ lights[lightIndex] };
+
+			Vector3 toLight{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
+			const float lightDistance{ toLight.Normalize() };
+
+			const float observedArea{ Vector3::Dot(closestHit.normal, toLight) };
+			if (observedArea <= 0.f)
+				continue;
+
+			const size_t index{ shadowFirst + shadowCount };
+			queues.shadowOriginX[index] = shadowOrigin.x;
+			queues.shadowOriginY[index] = shadowOrigin.y;
+			queues.shadowOriginZ[index] = shadowOrigin.z;
+			queues.shadowDirectionX[index] = toLight.x;
+			queues.shadowDirectionY[index] = toLight.y;
+			queues.shadowDirectionZ[index] = toLight.z;
+			queues.shadowMax[index] = light.type == LightType::Directional ? FLT_MAX : lightDistance;
+			queues.observedAreas[index] = observedArea;
+			queues.shadowRayIndices[index] = static_cast<uint16_t>(rayIndex);
+			queues.shadowLightIndices[index] = static_cast<uint16_t>(lightIndex);
+			++binStarts[lightIndex + 1];
+			++shadowCount;
+		}
+	}
+	queues.shadowRayCounts[tileIndex] = shadowCount;
+
+	//Exclusive prefix sum into bin l + 1, scattering then moves it on to where light l + 1 starts
+	uint32_t binStart{};
+	for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+	{
+		const uint32_t binCount{ binStarts[lightIndex + 1] };
+		binStarts[lightIndex + 1] = binStart;
+		binStart += binCount;
+	}
+	for (uint32_t shadowIndex{}; shadowIndex < shadowCount; ++shadowIndex)
+	{
+		queues.shadowLightBins[shadowFirst + binStarts[queues.shadowLightIndices[shadowFirst + shadowIndex] + 1]++] = shadowIndex;
+	}
+}
+
+void Renderer::TraceWavefrontShadowRays(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Wavefront::TraceShadowRays");
+
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+	const size_t numLights{ context.pLights->size() };
+	const size_t shadowFirst{ size_t(tileIndex) * TILE_SIZE * TILE_SIZE * numLights };
+	const uint32_t* binStarts{ queues.shadowLightBinStarts.data() + size_t(tileIndex) * (numLights + 1) };
+
+	//Light by light: rays towards one light are more coherent and keep hitting the occluder in its cache
+	OcclusionCache* pOcclusionCaches{ queues.occlusionCaches.data() + size_t(tileIndex) * numLights };
+	for (size_t lightIndex{}; lightIndex < numLights; ++lightIndex)
+	{
+		for (uint32_t bin{ binStarts[lightIndex] }; bin < binStarts[lightIndex + 1]; ++bin)
+		{
+			const size_t index{ shadowFirst + queues.shadowLightBins[shadowFirst + bin] };
+
+			Ray shadowRay{ { queues.shadowOriginX[index], queues.shadowOriginY[index], queues.shadowOriginZ[index] },
+				{ queues.shadowDirectionX[index], queues.shadowDirectionY[index], queues.shadowDirectionZ[index] } };
+			shadowRay.max = queues.shadowMax[index];
+
+			queues.isOccluded[index] = context.pScene->DoesHit(shadowRay, &pOcclusionCaches[lightIndex]);
+			DAE_COUNT_RAYS(ShadowRays, 1);
+			DAE_COUNT_RAYS(ShadowHits, queues.isOccluded[index]);
+		}
+	}
+}
+
+void Renderer::ShadeWavefront(const FrameContext& context, int tileIndex) const
+{
+	DAE_PROFILE_ZONE("Wavefront::Shade");
+
+	WavefrontQueues& queues{ *context.pWavefrontQueues };
+	const MaterialPool& materials{ *context.pMaterials };
+	const auto& lights = *context.pLights;
+	const size_t first{ size_t(tileIndex) * TILE_SIZE * TILE_SIZE };
+	const uint32_t count{ queues.rayCounts[tileIndex] };
+
+	HitRecord* hitRecords{ queues.hitRecords.data() + first };
+	ColorRGB* colors{ queues.colors.data() + first };
+	for (uint32_t rayIndex{}; rayIndex < count; ++rayIndex)
+	{
+		hitRecords[rayIndex] = queues.GetHit(first + rayIndex);
+		DAE_COUNT_RAYS(PrimaryHits, hitRecords[rayIndex].didHit);
+
+		//Unlit scenes just show the material color
+		colors[rayIndex] = lights.empty() && hitRecords[rayIndex].didHit ? materials.Shade(hitRecords[rayIndex].materialIndex) : ColorRGB{};
+	}
+
+	if (!lights.empty())
+	{
+		const size_t shadowFirst{ first * lights.size() };
+		const uint32_t shadowCount{ queues.shadowRayCounts[tileIndex] };
+
+		//BRDF inputs per unoccluded shadow ray, binned by material type (counting sort) so every type is shaded in one batch
+		HitRecord* shadowHitRecords{ queues.shadowHitRecords.data() + shadowFirst };
+		Vector3* toLights{ queues.toLights.data() + shadowFirst };
+		Vector3* viewDirections{ queues.viewDirections.data() + shadowFirst };
+		ColorRGB* brdfs{ queues.brdfs.data() + shadowFirst };
+		uint32_t* binnedIndices{ queues.binnedIndices.data() + shadowFirst };
+		uint32_t binStarts[static_cast<int>(MaterialType::Count) + 1]{};
+
+		for (uint32_t shadowIndex{}; shadowIndex < shadowCount; ++shadowIndex)
+		{
+			const size_t index{ shadowFirst + shadowIndex };
+			if (queues.isOccluded[index])
+				continue;
+
+			const uint32_t rayIndex{ queues.shadowRayIndices[index] };
+			shadowHitRecords[shadowIndex] = hitRecords[rayIndex];
+			toLights[shadowIndex] = { queues.shadowDirectionX[index], queues.shadowDirectionY[index], queues.shadowDirectionZ[index] };
+			viewDirections[shadowIndex] = -Vector3{ queues.directionX[first + rayIndex], queues.directionY[first + rayIndex], queues.directionZ[first + rayIndex] };
+			++binStarts[static_cast<int>(materials.GetType(hitRecords[rayIndex].materialIndex)) + 1];
+		}
+
+		for (int type{}; type < static_cast<int>(MaterialType::Count); ++type)
+		{
+			binStarts[type + 1] += binStarts[type];
+		}
+
+		uint32_t binEnds[static_cast<int>(MaterialType::Count)]{};
+		std::copy(binStarts, binStarts + static_cast<int>(MaterialType::Count), binEnds);
+		for (uint32_t shadowIndex{}; shadowIndex < shadowCount; ++shadowIndex)
+		{
+			if (queues.isOccluded[shadowFirst + shadowIndex])
+				continue;
+
+			const int type{ static_cast<int>(materials.GetType(shadowHitRecords[shadowIndex].materialIndex)) };
+			binnedIndices[binEnds[type]++] = shadowIndex;
+		}
+
+		{
+			DAE_PROFILE_ZONE("Material::Shade");
+			for (int type{}; type < static_cast<int>(MaterialType::Count); ++type)
 			{
-				finalColor = materials[closestHit.materialIndex]->Shade();
+				materials.ShadeBatch(MaterialType(type), binnedIndices + binStarts[type], binStarts[type + 1] - binStarts[type],
+					shadowHitRecords, toLights, viewDirections, brdfs);
+			}
+		}
 
-				/*float scale_t = (closestHit.t - 50.f) / 40.f;
-				finalColor = { scale_t,scale_t,scale_t };*/
+		//Hit by hit and light by light, so every pixel sums its lights in the same order as ShadePixel
+		for (uint32_t shadowIndex{}; shadowIndex < shadowCount; ++shadowIndex)
+		{
+			const size_t index{ shadowFirst + shadowIndex };
+			if (queues.isOccluded[index])
+				continue;
+
+			const uint32_t rayIndex{ queues.shadowRayIndices[index] };
+			const Light& light{ lights[queues.shadowLightIndices[index]] };
+			colors[rayIndex] += LightUtils::GetRadiance(light, hitRecords[rayIndex].origin) * brdfs[shadowIndex] * queues.observedAreas[index];
+		}
+	}
+
+	for (uint32_t rayIndex{}; rayIndex < count; ++rayIndex)
+	{
+		const uint32_t pixelIndex{ queues.pixelIndices[first + rayIndex] };
+		WritePixel(context, static_cast<int>(pixelIndex % m_Width), static_cast<int>(pixelIndex / m_Width), colors[rayIndex], hitRecords[rayIndex]);
+	}
+}
+
+ColorRGB Renderer::ShadePixel(const FrameContext& context, const Vector3& viewDirection, const HitRecord& closestHit, OcclusionCache* pOcclusionCaches) const
+{
+	ColorRGB finalColor{ };
+	if (!closestHit.didHit)
+		return finalColor;
+	DAE_COUNT_RAYS(PrimaryHits, 1);
+
+	const MaterialPool& materials{ *context.pMaterials };
+
+	//Unlit scenes just show the material color
+	const auto& lights = *context.pLights;
+	if (lights.empty())
+		return materials.Shade(closestHit.materialIndex);
+
+	//Start shadow rays slightly above the surface so they don't hit it again
+	const Vector3 shadowOrigin{ closestHit.origin + closestHit.normal * SHADOW_RAY_OFFSET };
+
+	for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+	{
+		const Light& light{ lights[lightIndex] };
+
+		Vector3 toLight{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
+		const float lightDistance{ toLight.Normalize() };
+
+		const float observedArea{ Vector3::Dot(closestHit.normal, toLight) };
+		if (observedArea <= 0.f)
+			continue;
+
+		Ray shadowRay{ shadowOrigin, toLight };
+		shadowRay.max = light.type == LightType::Directional ? FLT_MAX : lightDistance;
+		DAE_COUNT_RAYS(ShadowRays, 1);
+		const bool isOccluded{ context.pScene->DoesHit(shadowRay, &pOcclusionCaches[lightIndex]) };
+		DAE_PROFILE_STAGE_END(ShadowRays);
+		if (isOccluded)
+		{
+			DAE_COUNT_RAYS(ShadowHits, 1);
+			continue;
+		}
+
+		const ColorRGB brdf{ materials.Shade(closestHit.materialIndex, closestHit, toLight, -viewDirection) };
+		finalColor += LightUtils::GetRadiance(light, closestHit.origin) * brdf * observedArea;
+		DAE_PROFILE_STAGE_END(Shade);
+	}
+	return finalColor;
+}
+
+template<int Lanes>
+void Renderer::ShadePacket(const FrameContext& context, const RayPacket<Lanes>& packet, const PacketHitRecord<Lanes>& closestHits, ColorRGB* pColors, OcclusionCache* pOcclusionCaches) const
+{
+	const MaterialPool& materials{ *context.pMaterials };
+	const auto& lights = *context.pLights;
+
+	HitRecord hitRecords[Lanes]{};
+	Vector3 viewDirections[Lanes]{};
+	uint32_t typeMasks[static_cast<int>(MaterialType::Count)]{};
+
+	const uint32_t hitMask{ closestHits.hitMask & packet.activeMask };
+	for (uint32_t laneMask{ hitMask }; laneMask != 0; laneMask &= laneMask - 1)
+	{
+		const int lane{ std::countr_zero(laneMask) };
+		hitRecords[lane] = closestHits.GetHitRecord(lane);
+		viewDirections[lane] = -Vector3{ packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] };
+		typeMasks[static_cast<int>(materials.GetType(hitRecords[lane].materialIndex))] |= 1u << lane;
+	}
+	DAE_COUNT_RAYS(PrimaryHits, std::popcount(hitMask));
+	DAE_PROFILE_STAGE_END(Shade);
+
+	//Unlit scenes just show the material color
+	if (lights.empty())
+	{
+		for (uint32_t laneMask{ hitMask }; laneMask != 0; laneMask &= laneMask - 1)
+		{
+			const int lane{ std::countr_zero(laneMask) };
+			pColors[lane] = materials.Shade(hitRecords[lane].materialIndex);
+		}
+		return;
+	}
+
+	//Light by light, so every lane still sums its lights in the same order as ShadePixel
+	Vector3 toLights[Lanes]{};
+	float observedAreas[Lanes]{};
+	ColorRGB brdfs[Lanes]{};
+	for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+	{
+		const Light& light{ lights[lightIndex] };
+
+		uint32_t litMask{};
+		for (uint32_t laneMask{ hitMask }; laneMask != 0; laneMask &= laneMask - 1)
+		{
+			const int lane{ std::countr_zero(laneMask) };
+			const HitRecord& closestHit{ hitRecords[lane] };
+
+			toLights[lane] = LightUtils::GetDirectionToLight(light, closestHit.origin);
+			const float lightDistance{ toLights[lane].Normalize() };
+
+			observedAreas[lane] = Vector3::Dot(closestHit.normal, toLights[lane]);
+			if (observedAreas[lane] <= 0.f)
+				continue;
+
+			Ray shadowRay{ closestHit.origin + closestHit.normal * SHADOW_RAY_OFFSET, toLights[lane] };
+			shadowRay.max = light.type == LightType::Directional ? FLT_MAX : lightDistance;
+			DAE_COUNT_RAYS(ShadowRays, 1);
+			if (context.pScene->DoesHit(shadowRay, &pOcclusionCaches[lightIndex]))
+			{
+				DAE_COUNT_RAYS(ShadowHits, 1);
+				continue;
 			}
-			//Update Color in Buffer
-			finalColor.MaxToOne();
 
-			m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-				static_cast<uint8_t>(finalColor.r * 255),
-				static_cast<uint8_t>(finalColor.g * 255),
-				static_cast<uint8_t>(finalColor.b * 255));
+			litMask |= 1u << lane;
+		}
+		DAE_PROFILE_STAGE_END(ShadowRays);
+
+		for (int type{}; type < static_cast<int>(MaterialType::Count); ++type)
+		{
+			if (typeMasks[type] & litMask)
+				materials.ShadeBatch(MaterialType(type), typeMasks[type] & litMask, hitRecords, toLights, viewDirections, brdfs);
+		}
+
+		for (uint32_t laneMask{ litMask }; laneMask != 0; laneMask &= laneMask - 1)
+		{
+			const int lane{ std::countr_zero(laneMask) };
+			pColors[lane] += LightUtils::GetRadiance(light, hitRecords[lane].origin) * brdfs[lane] * observedAreas[lane];
 		}
+		DAE_PROFILE_STAGE_END(Shade);
+	}
+}
+
+Vector3 Renderer::GetRayDirection(const FrameContext& context, float x, float y) const
+{
+	//Same expressions as the direction tables, so pixel centers get exactly the same rays
+	Vector3 direction{ context.cameraToWorld.TransformVector(
+		(2 * x / m_Width - 1) * context.aspectRatio * context.fov,
+		(1 - 2 * y / m_Height) * context.fov,
+		1.f) };
+	direction.Normalize();
+	return direction;
+}
+
+void Renderer::WritePixel(const FrameContext& context, int px, int py, const ColorRGB& finalColor, const HitRecord& closestHit) const
+{
+	//Update Color in Buffer, tone mapping happens when the frame gets converted
+	context.pFrameBuffer[px + (py * m_Width)] = finalColor;
+
+	if (context.pEdgeSamples)
+	{
+		ColorRGB toneMapped{ finalColor };
+		toneMapped.MaxToOne();
+		context.pEdgeSamples[px + (py * m_Width)] = { GetLuminance(toneMapped), closestHit.didHit ? uint16_t(closestHit.materialIndex) : NO_HIT_KEY };
 	}
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::ConvertFrontBuffer(uint32_t* pDestination, int pitch, PixelFormat format) const
+{
+	DAE_PROFILE_ZONE("Renderer::ConvertFrontBuffer");
+	//Only the output size and the front buffer are read, Render may be changing everything else
+	const FrameBuffer& frontBuffer{ m_FrameBuffers[m_FrontBuffer.load(std::memory_order_acquire)] };
+	const ColorQuantizer& quantizer{ m_Quantizers[static_cast<int>(format)] };
+
+	const auto getRow = [pDestination, pitch](int py)
+		{
+			return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(pDestination) + size_t(py) * pitch);
+		};
+
+	if (frontBuffer.width == m_OutputWidth && frontBuffer.height == m_OutputHeight)
+	{
+		for (int py{}; py < m_OutputHeight; ++py)
+		{
+			quantizer.QuantizeRow(frontBuffer.pixels.data() + size_t(py) * m_OutputWidth, getRow(py), m_OutputWidth);
+		}
+		return;
+	}
+
+	//Nearest neighbour upscale: every source row is quantized once, output rows that land on the same source row are copies
+	std::vector<uint32_t> sourceRow(frontBuffer.width);
+	std::vector<int> sourceColumns(m_OutputWidth);
+	for (int px{}; px < m_OutputWidth; ++px)
+	{
+		sourceColumns[px] = static_cast<int>(int64_t(px) * frontBuffer.width / m_OutputWidth);
+	}
+
+	int previousSourceY{ -1 };
+	for (int py{}; py < m_OutputHeight; ++py)
+	{
+		uint32_t* pRow{ getRow(py) };
+		const int sourceY{ static_cast<int>(int64_t(py) * frontBuffer.height / m_OutputHeight) };
+		if (sourceY == previousSourceY)
+		{
+			std::memcpy(pRow, getRow(py - 1), m_OutputWidth * sizeof(uint32_t));
+			continue;
+		}
+
+		quantizer.QuantizeRow(frontBuffer.pixels.data() + size_t(sourceY) * frontBuffer.width, sourceRow.data(), frontBuffer.width);
+		for (int px{}; px < m_OutputWidth; ++px)
+		{
+			pRow[px] = sourceRow[sourceColumns[px]];
+		}
+		previousSourceY = sourceY;
+	}
+}
+
+bool Renderer::SaveBufferToImage(const char* filePath) const
+{
+	//24 bit BMP: little endian headers, rows bottom-up and padded to 4 bytes
+	const uint32_t rowSize{ (3u * m_OutputWidth + 3u) & ~3u };
+	const uint32_t imageSize{ rowSize * m_OutputHeight };
+
+	uint8_t header[54]{ 'B', 'M' };
+	const auto write32 = [&header](int offset, uint32_t value)
+		{
+			for (int byte{}; byte < 4; ++byte)
+				header[offset + byte] = static_cast<uint8_t>(value >> (8 * byte));
+		};
+	write32(2, sizeof(header) + imageSize); //file size
+	write32(10, sizeof(header)); //pixel data offset
+	write32(14, 40); //info header size
+	write32(18, static_cast<uint32_t>(m_OutputWidth));
+	write32(22, static_cast<uint32_t>(m_OutputHeight));
+	header[26] = 1; //planes
+	header[28] = 24; //bits per pixel
+	write32(34, imageSize);
+
+	std::vector<uint32_t> pixels(size_t(m_OutputWidth) * m_OutputHeight);
+	ConvertFrontBuffer(pixels.data(), m_OutputWidth * 4);
+
+	std::ofstream file{ filePath, std::ios::binary };
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	std::vector<uint8_t> row(rowSize);
+	for (int py{ m_OutputHeight - 1 }; py >= 0; --py)
+	{
+		for (int px{}; px < m_OutputWidth; ++px)
+		{
+			const uint32_t pixel{ pixels[px + py * m_OutputWidth] };
+			row[px * 3] = static_cast<uint8_t>(pixel);
+			row[px * 3 + 1] = static_cast<uint8_t>(pixel >> 8);
+			row[px * 3 + 2] = static_cast<uint8_t>(pixel >> 16);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), rowSize);
+	}
+	return static_cast<bool>(file);
+}
+
+void Renderer::SetThreadCount(uint32_t numThreads)
+{
+	m_pThreadPool = std::make_unique<ThreadPool>(numThreads);
+}
+
+uint32_t Renderer::GetThreadCount() const
+{
+	return m_pThreadPool->GetThreadCount();
+}
+
+void Renderer::SetProgressive(bool isProgressive)
+{
+	m_IsProgressive = isProgressive;
+	if (!isProgressive)
+	{
+		m_AccumulatedPixels.clear();
+		m_AccumulatedFrames = 0;
+		m_ProgressiveFrameStats.store(0, std::memory_order_relaxed);
+	}
+}
+
+float Renderer::GetAntiAliasedFraction() const
+{
+	const uint64_t counts{ m_AntiAliasedFrameCounts.load(std::memory_order_relaxed) };
+	const uint32_t numPixels{ uint32_t(counts) };
+	if (numPixels == 0)
+		return 0.f;
+	return float(counts >> 32) / numPixels;
+}
+
+uint32_t Renderer::GetAccumulatedFrameCount() const
+{
+	return uint32_t(m_ProgressiveFrameStats.load(std::memory_order_relaxed) >> 32);
+}
+
+float Renderer::GetConvergedFraction() const
+{
+	return std::bit_cast<float>(uint32_t(m_ProgressiveFrameStats.load(std::memory_order_relaxed)));
+}
+
+void Renderer::SetTargetFrameTime(float targetMs)
+{
+	m_TargetFrameTime = std::max(targetMs, 0.f);
+	if (m_TargetFrameTime == 0.f)
+		m_ResolutionScale = 1.f;
+}
+
+void Renderer::SetPacketSize(int packetSize)
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	m_PacketSize = (packetSize == 2 || packetSize == 4) ? packetSize : 1;
 }
@@ -1,35 +1,269 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
-struct SDL_Window;
-struct SDL_Surface;
+#include "ColorRGB.h"
+#include "ColorQuantizer.h"
+#include "DataTypes.h"
+#include "Matrix.h"
+#include "RayStats.h"
 
 namespace dae
 {
 	class Scene;
+	class MaterialPool;
+	class ThreadPool;
+	template<int Lanes>
+	struct RayPacket;
+	template<int Lanes>
+	struct PacketHitRecord;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Renders into float frame buffers of its own, presenting them (e.g. to an SDL window) is up to the caller
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		bool SaveBufferToImage() const;
+		//Traces into the back buffer and swaps it to the front once every tile is done
+		//Only one Render call may run at a time, the front buffer can be read meanwhile
+		void Render(Scene* pScene);
+		//Converts the front buffer (last finished frame) to rows of packed pixels, pitch in bytes
+		//Safe to call from another thread while Render traces the next frame
+		void ConvertFrontBuffer(uint32_t* pDestination, int pitch, PixelFormat format = PixelFormat::ARGB8888) const;
+		//Writes the last finished frame as BMP, returns true on success
+		bool SaveBufferToImage(const char* filePath = "RayTracing_Buffer.bmp") const;
+
+		//Output size, ConvertFrontBuffer and SaveBufferToImage always produce this many pixels
+		int GetWidth() const { return m_OutputWidth; }
+		int GetHeight() const { return m_OutputHeight; }
+		//Camera rays traced by the last Render call, shadow rays not included
+		uint64_t GetPrimaryRayCount() const { return m_PrimaryRayCount.load(); }
+		//Ray and intersection counts of the last Render call, all zero unless built with DAE_RAY_STATS
+		const RayCounters& GetRayCounters() const { return m_RayCounters; }
+
+		//0 picks one thread per hardware core, 1 renders serially on the calling thread
+		void SetThreadCount(uint32_t numThreads);
+		uint32_t GetThreadCount() const;
+
+		//Primary rays are traced in packetSize x packetSize packets (2 or 4), 1 traces every ray on its own
+		void SetPacketSize(int packetSize);
+		int GetPacketSize() const { return m_PacketSize; }
+
+		//Wavefront mode runs the frame breadth first: ray generation, closest hits, shadow ray generation, occlusion and shading
+		//each run over the whole frame before the next stage starts, reading and writing SoA queues
+		//Same image as the regular mode, progressive mode ignores it
+		void SetWavefront(bool isWavefront) { m_IsWavefront = isWavefront; }
+		bool IsWavefront() const { return m_IsWavefront; }
+
+		//Progressive mode traces one jittered sample per pixel per frame and averages them while the camera and scene stay put
+		//Pixels stop tracing once the standard error of their luminance drops below threshold * luminance
+		//Samples are traced as single rays, the packet size doesn't apply
+		void SetProgressive(bool isProgressive);
+		bool IsProgressive() const { return m_IsProgressive; }
+		void SetConvergenceThreshold(float threshold) { m_ConvergenceThreshold = threshold; }
+		float GetConvergenceThreshold() const { return m_ConvergenceThreshold; }
+		//Samples per pixel so far (converged pixels stop counting) and the share of pixels that stopped, as of the last finished frame
+		//Safe to call while Render runs
+		uint32_t GetAccumulatedFrameCount() const;
+		float GetConvergedFraction() const;
+
+		//Adaptive anti-aliasing replaces the center sample by 8 stratified ones, but only for pixels whose center sample
+		//differs from a neighbour's in hit/miss, material or luminance (more than threshold, after tone mapping)
+		//Progressive mode jitters its samples anyway and ignores this
+		void SetAdaptiveAntiAliasing(bool isEnabled) { m_IsAdaptiveAntiAliasing = isEnabled; }
+		bool IsAdaptiveAntiAliasing() const { return m_IsAdaptiveAntiAliasing; }
+		void SetAntiAliasingThreshold(float threshold) { m_AntiAliasingThreshold = threshold; }
+		float GetAntiAliasingThreshold() const { return m_AntiAliasingThreshold; }
+		//Share of the pixels that got the extra samples in the last finished frame, safe to call while Render runs
+		float GetAntiAliasedFraction() const;
+
+		//Dynamic resolution traces a scaled down frame, the scale is picked after every frame so Render takes about targetMs
+		//Converting the front buffer upscales it to the output size (nearest neighbour), 0 turns it off again
+		void SetTargetFrameTime(float targetMs);
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+		float GetResolutionScale() const { return m_ResolutionScale; }
 
 	private:
-		SDL_Window* m_pWindow{};
+		struct FrameContext;
 
-		SDL_Surface* m_pBuffer{};
-		uint32_t* m_pBufferPixels{};
+		static constexpr int TILE_SIZE{ 32 };
+		static constexpr float SHADOW_RAY_OFFSET{ 0.001f };
 
+		static constexpr uint32_t MIN_CONVERGENCE_SAMPLES{ 16 };
+		static constexpr uint32_t MAX_PROGRESSIVE_SAMPLES{ 4096 };
+		//Dark pixels are judged against this luminance instead, so noise far below one 8 bit step doesn't keep them going
+		static constexpr float MIN_CONVERGENCE_LUMINANCE{ 0.1f };
+
+		static constexpr float MIN_RESOLUTION_SCALE{ 0.25f };
+		//Smaller scale changes are skipped, every change rebuilds the direction tables and restarts progressive accumulation
+		static constexpr float RESOLUTION_SCALE_STEP{ 0.02f };
+
+		//Unclamped radiance per pixel, Render fills one while the other holds the last finished frame
+		//Both keep the capacity of a full size frame, dynamic resolution only changes how much of it is used
+		struct FrameBuffer
+		{
+			std::vector<ColorRGB> pixels{};
+			int width{};
+			int height{};
+		};
+		FrameBuffer m_FrameBuffers[2]{};
+		std::atomic<uint32_t> m_FrontBuffer{ 0 };
+		std::atomic<uint64_t> m_PrimaryRayCount{};
+		RayCounters m_RayCounters{};
+
+		//One per PixelFormat, so the row kernels are only picked once
+		ColorQuantizer m_Quantizers[2]{ ColorQuantizer{ PixelFormat::ARGB8888 }, ColorQuantizer{ PixelFormat::ABGR8888 } };
+
+		int m_OutputWidth{};
+		int m_OutputHeight{};
+		//Traced resolution of the current frame, below the output size when dynamic resolution kicks in
 		int m_Width{};
 		int m_Height{};
+
+		float m_TargetFrameTime{};
+		float m_ResolutionScale{ 1.f };
+
+		std::unique_ptr<ThreadPool> m_pThreadPool{};
+
+		//Camera space ray direction per column (x) and per row (y), rebuilt when the resolution or FOV changes
+		std::vector<float> m_ColumnDirections{};
+		std::vector<float> m_RowDirections{};
+		float m_DirectionTablesFov{ -1.f };
+
+		int m_PacketSize{ 4 };
+
+		//Running sums per pixel, luminance statistics use Welford's algorithm
+		struct AccumulatedPixel
+		{
+			ColorRGB colorSum{};
+			float luminanceMean{};
+			float luminanceM2{};
+			uint32_t sampleCount{};
+			bool isConverged{};
+		};
+		std::vector<AccumulatedPixel> m_AccumulatedPixels{};
+		bool m_IsProgressive{ false };
+		float m_ConvergenceThreshold{ 0.01f };
+		uint32_t m_AccumulatedFrames{};
+		std::atomic<uint32_t> m_ConvergedPixelCount{};
+		//Last finished frame: accumulated frames in the high half, converged share of the traced pixels (float bits) in the low half
+		std::atomic<uint64_t> m_ProgressiveFrameStats{};
+
+		//Center sample summary per pixel, the anti-aliasing pass compares neighbours with it
+		struct EdgeSample
+		{
+			float luminance{};
+			//Material index, NO_HIT_KEY for misses
+			uint16_t key{};
+		};
+		static constexpr uint16_t NO_HIT_KEY{ 0xFFFF };
+		std::vector<EdgeSample> m_EdgeSamples{};
+		bool m_IsAdaptiveAntiAliasing{ false };
+		float m_AntiAliasingThreshold{ 0.1f };
+		std::atomic<uint32_t> m_AntiAliasedPixelCount{};
+		//Last finished frame: anti-aliased pixels in the high half, traced pixels in the low half
+		std::atomic<uint64_t> m_AntiAliasedFrameCounts{};
+
+		//Stage queues of the wavefront mode, every tile owns a fixed slice (TILE_SIZE * TILE_SIZE rays, that many times the light count
+		//shadow rays), so the stages never have to synchronize to append
+		struct WavefrontQueues
+		{
+			//Primary rays, in packet order inside the tile, and their closest hits
+			std::vector<float> directionX{};
+			std::vector<float> directionY{};
+			std::vector<float> directionZ{};
+			std::vector<uint32_t> pixelIndices{};
+			std::vector<uint32_t> rayCounts{};
+
+			std::vector<float> hitOriginX{};
+			std::vector<float> hitOriginY{};
+			std::vector<float> hitOriginZ{};
+			std::vector<float> hitNormalX{};
+			std::vector<float> hitNormalY{};
+			std::vector<float> hitNormalZ{};
+			std::vector<float> hitT{};
+			std::vector<unsigned char> hitMaterialIndices{};
+			std::vector<uint8_t> didHit{};
+
+			//Shadow rays of the hits that face a light, hit by hit and light by light
+			std::vector<float> shadowOriginX{};
+			std::vector<float> shadowOriginY{};
+			std::vector<float> shadowOriginZ{};
+			std::vector<float> shadowDirectionX{};
+			std::vector<float> shadowDirectionY{};
+			std::vector<float> shadowDirectionZ{};
+			std::vector<float> shadowMax{};
+			std::vector<float> observedAreas{};
+			//Ray index inside the tile and light index
+			std::vector<uint16_t> shadowRayIndices{};
+			std::vector<uint16_t> shadowLightIndices{};
+			std::vector<uint8_t> isOccluded{};
+			std::vector<uint32_t> shadowRayCounts{};
+			//Shadow ray indices inside the tile binned by light (counting sort), per tile the light count + 1 bin starts
+			//Light l's rays are shadowLightBins[binStarts[l]] up to shadowLightBins[binStarts[l + 1]]
+			std::vector<uint32_t> shadowLightBins{};
+			std::vector<uint32_t> shadowLightBinStarts{};
+
+			//Shading scratch, sliced per tile like the queues above so no stage allocates per frame
+			std::vector<HitRecord> hitRecords{};
+			std::vector<ColorRGB> colors{};
+			//BRDF inputs per unoccluded shadow ray, and the order they get shaded in
+			std::vector<HitRecord> shadowHitRecords{};
+			std::vector<Vector3> toLights{};
+			std::vector<Vector3> viewDirections{};
+			std::vector<ColorRGB> brdfs{};
+			std::vector<uint32_t> binnedIndices{};
+			//One per light per tile, kept from frame to frame
+			std::vector<OcclusionCache> occlusionCaches{};
+
+			HitRecord GetHit(size_t index) const;
+			void SetHit(size_t index, const HitRecord& hitRecord);
+		};
+		WavefrontQueues m_WavefrontQueues{};
+		bool m_IsWavefront{ false };
+
+		//What the accumulated samples were traced with, any change starts over
+		Matrix m_AccumulatedCameraToWorld{};
+		float m_AccumulatedFov{};
+		uint64_t m_AccumulatedSceneVersion{};
+
+		void UpdateDirectionTables(float fovAngle);
+		void UpdateResolutionScale(float frameTime);
+		void GetTileBounds(int tileIndex, int& startX, int& startY, int& endX, int& endY) const;
+		void RenderTile(const FrameContext& context, int tileIndex) const;
+		//Second pass, needs the edge samples of every tile around it
+		void AntiAliasTile(const FrameContext& context, int tileIndex) const;
+		void RenderTileRays(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const;
+		void RenderTileProgressive(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const;
+		template<int PacketSize>
+		void RenderTilePackets(const FrameContext& context, OcclusionCache* pOcclusionCaches, int startX, int startY, int endX, int endY) const;
+
+		//Wavefront stages, one tile's slice of the queues each
+		void RenderWavefront(const FrameContext& context, uint32_t numTiles);
+		void GenerateWavefrontRays(const FrameContext& context, int tileIndex) const;
+		void TraceWavefrontRays(const FrameContext& context, int tileIndex) const;
+		template<int Lanes>
+		void TraceWavefrontPackets(const FrameContext& context, uint32_t first, uint32_t count) const;
+		void GenerateWavefrontShadowRays(const FrameContext& context, int tileIndex) const;
+		void TraceWavefrontShadowRays(const FrameContext& context, int tileIndex) const;
+		void ShadeWavefront(const FrameContext& context, int tileIndex) const;
+
+		//pOcclusionCaches holds one cache per light, owned by the calling thread
+		ColorRGB ShadePixel(const FrameContext& context, const Vector3& viewDirection, const HitRecord& closestHit, OcclusionCache* pOcclusionCaches) const;
+		//ShadePixel for every active lane, same colors, but the lanes are binned by material type and every bin is shaded in one batch
+		template<int Lanes>
+		void ShadePacket(const FrameContext& context, const RayPacket<Lanes>& packet, const PacketHitRecord<Lanes>& closestHits, ColorRGB* pColors, OcclusionCache* pOcclusionCaches) const;
+		//Direction of the primary ray through (x, y) in pixel coordinates, (px + 0.5, py + 0.5) is the pixel center
+		Vector3 GetRayDirection(const FrameContext& context, float x, float y) const;
+		void WritePixel(const FrameContext& context, int px, int py, const ColorRGB& finalColor, const HitRecord& closestHit) const;
 	};
 }
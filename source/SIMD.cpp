@@ -0,0 +1,96 @@
+#include "SIMD.h"
+
+#include <cstdint>
+
+#if DAE_SIMD_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace dae
+{
+	namespace SIMD
+	{
+#if DAE_SIMD_X64
+		static void CpuId(uint32_t leaf, uint32_t subLeaf, uint32_t registers[4])
+		{
+#if defined(_MSC_VER)
+			int values[4]{};
+			__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subLeaf));
+			for (int index{}; index < 4; ++index)
+			{
+				registers[index] = static_cast<uint32_t>(values[index]);
+			}
+#else
+			__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		}
+
+		static uint64_t GetEnabledStateMask()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t low{}, high{};
+			__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (uint64_t(high) << 32) | low;
+#endif
+		}
+
+		static InstructionSet DetectInstructionSet()
+		{
+			uint32_t registers[4]{};
+			CpuId(0, 0, registers);
+			if (registers[0] < 7)
+				return InstructionSet::Scalar;
+
+			//The OS has to save the wide registers on a context switch (OSXSAVE + XCR0), not just the CPU support them
+			CpuId(1, 0, registers);
+			const bool hasOsxSave{ (registers[2] & (1u << 27)) != 0 };
+			if (!hasOsxSave)
+				return InstructionSet::Scalar;
+
+			const uint64_t enabledState{ GetEnabledStateMask() };
+			const bool hasYmmState{ (enabledState & 0x6) == 0x6 };
+			const bool hasZmmState{ (enabledState & 0xE6) == 0xE6 };
+
+			CpuId(7, 0, registers);
+			const bool hasAVX2{ (registers[1] & (1u << 5)) != 0 };
+			const bool hasAVX512F{ (registers[1] & (1u << 16)) != 0 };
+
+			if (hasAVX512F && hasZmmState)
+				return InstructionSet::AVX512;
+			if (hasAVX2 && hasYmmState)
+				return InstructionSet::AVX2;
+			return InstructionSet::Scalar;
+		}
+#else
+		static InstructionSet DetectInstructionSet()
+		{
+			return InstructionSet::Scalar;
+		}
+#endif
+
+		InstructionSet GetInstructionSet()
+		{
+			static const InstructionSet instructionSet{ DetectInstructionSet() };
+			return instructionSet;
+		}
+
+		const char* GetInstructionSetName(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::AVX2:
+				return "AVX2";
+			case InstructionSet::AVX512:
+				return "AVX-512";
+			default:
+				return "Scalar";
+			}
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+//Instruction set selection for the hand-vectorized kernels
+//Kernels are compiled for every instruction set regardless of the compiler flags and picked at runtime,
+//so one binary runs on any x64 CPU and still uses the widest vectors available.
+#if defined(_M_X64) || defined(__x86_64__)
+#define DAE_SIMD_X64 1
+#include <immintrin.h>
+#else
+#define DAE_SIMD_X64 0
+#endif
+
+//MSVC lets any function use any intrinsic, GCC/Clang need the target enabled per function
+//mul+add must not be contracted to FMA, the vector kernels have to round exactly like the scalar ones
+#if DAE_SIMD_X64 && defined(__clang__)
+#define DAE_TARGET_AVX2 __attribute__((target("avx2")))
+#define DAE_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif DAE_SIMD_X64 && defined(__GNUC__)
+#define DAE_TARGET_AVX2 __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define DAE_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define DAE_TARGET_AVX2
+#define DAE_TARGET_AVX512
+#endif
+
+namespace dae
+{
+	namespace SIMD
+	{
+		enum class InstructionSet
+		{
+			Scalar,
+			AVX2,
+			AVX512
+		};
+
+		//Widest instruction set both the CPU and the OS support, detected once
+		InstructionSet GetInstructionSet();
+		const char* GetInstructionSetName(InstructionSet instructionSet);
+	}
+}
@@ -1,51 +1,331 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "Profiler.h"
+#include "Timer.h"
 
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})})
+	Scene::Scene()
 	{
+		m_Materials.Add(Material_SolidColor{ {1,0,0} });
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
+		m_MeshInstances.reserve(32);
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
+	Scene* Scene::CreateByName(const std::string& sceneName)
 	{
-		for(auto& pMaterial : m_Materials)
+		if (sceneName == "W1")
+			return new Scene_W1();
+		if (sceneName == "W3")
+			return new Scene_W3();
+		if (sceneName == "W4")
+			return new Scene_W4();
+		if (sceneName == "Instancing")
+			return new Scene_Instancing();
+		return nullptr;
+	}
+
+	std::vector<std::string> Scene::GetSceneNames()
+	{
+		return { "W1", "W3", "W4", "Instancing" };
+	}
+
+	Scene::~Scene() = default;
+
+	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	{
+		//Planes first, walls usually end the ray early and let the BVH skip everything behind them
+		for (const auto& plane : m_PlaneGeometries)
 		{
-			delete pMaterial;
-			pMaterial = nullptr;
+			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
 		}
 
-		m_Materials.clear();
+		m_SphereBVH.Intersect(ray, closestHit.t, [&](uint32_t first, uint32_t count)
+			{
+				m_SpherePool.IntersectClosest(first, count, ray, closestHit);
+			});
+
+		const auto& instanceIndices = m_MeshInstanceBVH.GetPrimitiveIndices();
+		m_MeshInstanceBVH.Intersect(ray, closestHit.t, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					IntersectMeshInstance(instanceIndices[index], ray, closestHit);
+				}
+			});
 	}
 
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	template<int Lanes>
+	void Scene::GetClosestHit(const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& closestHits) const
 	{
-		//todo W1
-		for (const auto& sphere : this->GetSphereGeometries())
+		if (!packet.IsCoherent())
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				if (!((packet.activeMask >> lane) & 1))
+					continue;
+
+				HitRecord closestHit{};
+				GetClosestHit(packet.GetRay(lane), closestHit);
+				closestHits.SetHitRecord(lane, closestHit);
+			}
+			return;
 		}
-		for (const auto& plane : this->GetPlaneGeometries())
+
+		for (const auto& plane : m_PlaneGeometries)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			GeometryUtils::HitTest_Plane(plane, packet, closestHits);
 		}
+
+		const auto& sphereIndices = m_SphereBVH.GetPrimitiveIndices();
+		m_SphereBVH.IntersectPacket(packet, closestHits.t, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					GeometryUtils::HitTest_Sphere(m_SphereGeometries[sphereIndices[index]], packet, closestHits);
+				}
+			});
+
+		const auto& instanceIndices = m_MeshInstanceBVH.GetPrimitiveIndices();
+		m_MeshInstanceBVH.IntersectPacket(packet, closestHits.t, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					IntersectMeshInstance(instanceIndices[index], packet, closestHits);
+				}
+			});
 	}
 
-	bool Scene::DoesHit(const Ray& ray) const
+	template void Scene::GetClosestHit<4>(const RayPacket<4>&, PacketHitRecord<4>&) const;
+	template void Scene::GetClosestHit<16>(const RayPacket<16>&, PacketHitRecord<16>&) const;
+
+	bool Scene::DoesHit(const Ray& ray, OcclusionCache* pCache) const
 	{
-		//todo W3
-		assert(false && "No Implemented Yet!");
+		uint32_t occluderIndex{};
+
+		if (pCache)
+		{
+			switch (pCache->type)
+			{
+			case OcclusionCache::PrimitiveType::Sphere:
+				if (pCache->index < m_SpherePool.GetSize() && m_SpherePool.IntersectAny(pCache->index, 1, ray, occluderIndex))
+					return true;
+				break;
+			case OcclusionCache::PrimitiveType::Plane:
+				if (pCache->index < m_PlaneGeometries.size() && GeometryUtils::HitTest_Plane(m_PlaneGeometries[pCache->index], ray))
+					return true;
+				break;
+			case OcclusionCache::PrimitiveType::MeshInstance:
+				if (pCache->index < m_InstanceTransforms.size() && DoesHitMeshInstance(pCache->index, ray))
+					return true;
+				break;
+			default:
+				break;
+			}
+		}
+
+		//Spheres before planes: planes usually enclose the scene and rarely sit between a surface and a light inside it
+		const bool isSphereHit{ m_SphereBVH.IntersectAny(ray, [&](uint32_t first, uint32_t count)
+			{
+				return m_SpherePool.IntersectAny(first, count, ray, occluderIndex);
+			}) };
+
+		if (isSphereHit)
+		{
+			if (pCache)
+				*pCache = { OcclusionCache::PrimitiveType::Sphere, occluderIndex };
+			return true;
+		}
+
+		const auto& instanceIndices = m_MeshInstanceBVH.GetPrimitiveIndices();
+		const bool isMeshHit{ m_MeshInstanceBVH.IntersectAny(ray, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					if (DoesHitMeshInstance(instanceIndices[index], ray))
+					{
+						occluderIndex = instanceIndices[index];
+						return true;
+					}
+				}
+				return false;
+			}) };
+
+		if (isMeshHit)
+		{
+			if (pCache)
+				*pCache = { OcclusionCache::PrimitiveType::MeshInstance, occluderIndex };
+			return true;
+		}
+
+		for (uint32_t planeIndex{}; planeIndex < m_PlaneGeometries.size(); ++planeIndex)
+		{
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[planeIndex], ray))
+			{
+				if (pCache)
+					*pCache = { OcclusionCache::PrimitiveType::Plane, planeIndex };
+				return true;
+			}
+		}
+
 		return false;
 	}
 
+	bool Scene::IntersectMeshInstance(uint32_t instanceIndex, const Ray& ray, HitRecord& closestHit) const
+	{
+		const TriangleMesh& mesh{ m_TriangleMeshGeometries[m_MeshInstances[instanceIndex].meshIndex] };
+		const InstanceTransform& transform{ m_InstanceTransforms[instanceIndex] };
+
+		//The direction is not renormalized, so t means the same in mesh and world space
+		const Ray meshRay{ transform.worldToMesh.TransformPoint(ray.origin), transform.worldToMesh.TransformVector(ray.direction), ray.min, ray.max };
+		if (!GeometryUtils::HitTest_TriangleMesh(mesh, meshRay, closestHit))
+			return false;
+
+		closestHit.origin = ray.origin + ray.direction * closestHit.t;
+		closestHit.normal = transform.normalToWorld.TransformVector(closestHit.normal).Normalized();
+		return true;
+	}
+
+	template<int Lanes>
+	uint32_t Scene::IntersectMeshInstance(uint32_t instanceIndex, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& closestHits) const
+	{
+		const TriangleMesh& mesh{ m_TriangleMeshGeometries[m_MeshInstances[instanceIndex].meshIndex] };
+		const InstanceTransform& transform{ m_InstanceTransforms[instanceIndex] };
+
+		RayPacket<Lanes> meshPacket{ packet };
+		meshPacket.origin = transform.worldToMesh.TransformPoint(packet.origin);
+		for (int lane{}; lane < Lanes; ++lane)
+		{
+			meshPacket.SetDirection(lane, transform.worldToMesh.TransformVector(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]));
+		}
+
+		const uint32_t hitMask{ GeometryUtils::HitTest_TriangleMesh(mesh, meshPacket, closestHits) };
+		for (int lane{}; lane < Lanes; ++lane)
+		{
+			if (!((hitMask >> lane) & 1))
+				continue;
+
+			const float t{ closestHits.t[lane] };
+			closestHits.originX[lane] = packet.origin.x + packet.directionX[lane] * t;
+			closestHits.originY[lane] = packet.origin.y + packet.directionY[lane] * t;
+			closestHits.originZ[lane] = packet.origin.z + packet.directionZ[lane] * t;
+
+			const Vector3 normal{ transform.normalToWorld.TransformVector(closestHits.normalX[lane], closestHits.normalY[lane], closestHits.normalZ[lane]).Normalized() };
+			closestHits.normalX[lane] = normal.x;
+			closestHits.normalY[lane] = normal.y;
+			closestHits.normalZ[lane] = normal.z;
+		}
+		return hitMask;
+	}
+
+	bool Scene::DoesHitMeshInstance(uint32_t instanceIndex, const Ray& ray) const
+	{
+		const TriangleMesh& mesh{ m_TriangleMeshGeometries[m_MeshInstances[instanceIndex].meshIndex] };
+		const InstanceTransform& transform{ m_InstanceTransforms[instanceIndex] };
+
+		const Ray meshRay{ transform.worldToMesh.TransformPoint(ray.origin), transform.worldToMesh.TransformVector(ray.direction), ray.min, ray.max };
+		return GeometryUtils::HitTest_TriangleMesh(mesh, meshRay);
+	}
+
+	void Scene::UpdateAccelerationStructures()
+	{
+		DAE_PROFILE_ZONE("Scene::UpdateAccelerationStructures");
+		UpdateSphereBVH();
+		UpdateMeshInstanceBVH();
+	}
+
+	void Scene::UpdateSphereBVH()
+	{
+		const bool hasNewGeometry{ m_SphereBVH.GetPrimitiveCount() != m_SphereGeometries.size() };
+		if (!hasNewGeometry && !m_HasGeometryMoved)
+			return;
+
+		std::vector<AABB> sphereBounds{};
+		sphereBounds.reserve(m_SphereGeometries.size());
+		for (const auto& sphere : m_SphereGeometries)
+		{
+			const Vector3 extent{ sphere.radius, sphere.radius, sphere.radius };
+			sphereBounds.push_back({ sphere.origin - extent, sphere.origin + extent });
+		}
+
+		if (hasNewGeometry)
+		{
+			m_SphereBVH.SetLeafBatchSize(m_SpherePool.GetLaneCount());
+			m_SphereBVHRebuilder.Build(m_SphereBVH, sphereBounds);
+		}
+		else
+		{
+			m_SphereBVHRebuilder.Refit(m_SphereBVH, sphereBounds);
+		}
+
+		m_SpherePool.Build(m_SphereGeometries, m_SphereBVH.GetPrimitiveIndices());
+
+		m_HasGeometryMoved = false;
+		++m_Version;
+	}
+
+	void Scene::UpdateMeshInstanceBVH()
+	{
+		if (m_MeshInstances.empty() && m_MeshInstanceBVH.IsEmpty())
+			return;
+
+		//Mesh BVHs are built when triangles were added and refit when vertices were edited, moving a mesh never touches them
+		bool hasChanged{ m_InstanceTransforms.size() != m_MeshInstances.size() };
+		for (auto& mesh : m_TriangleMeshGeometries)
+		{
+			if (!mesh.IsBVHDirty())
+				continue;
+
+			if (!mesh.bvh.IsEmpty() && mesh.bvh.GetPrimitiveCount() == mesh.indices.size() / 3)
+				mesh.RefitBVH();
+			else
+				mesh.UpdateBVH();
+			hasChanged = true;
+		}
+
+		m_InstanceTransforms.resize(m_MeshInstances.size());
+		std::vector<AABB> instanceBounds(m_MeshInstances.size());
+		for (size_t instanceIndex{}; instanceIndex < m_MeshInstances.size(); ++instanceIndex)
+		{
+			const MeshInstance& instance{ m_MeshInstances[instanceIndex] };
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[instance.meshIndex] };
+
+			const Matrix meshToWorld{ mesh.GetTransform() * instance.transform };
+			InstanceTransform& transform{ m_InstanceTransforms[instanceIndex] };
+			hasChanged |= !(transform.meshToWorld == meshToWorld);
+			transform.meshToWorld = meshToWorld;
+			transform.worldToMesh = Matrix::Inverse(meshToWorld);
+			transform.normalToWorld = Matrix::Transpose(transform.worldToMesh);
+
+			if (mesh.bvh.IsEmpty())
+				continue;
+
+			//World bounds of the mesh bounds' corners
+			const BVHNode& root{ mesh.bvh.GetNodes()[0] };
+			for (int corner{}; corner < 8; ++corner)
+			{
+				instanceBounds[instanceIndex].Grow(meshToWorld.TransformPoint(
+					corner & 1 ? root.boundsMax.x : root.boundsMin.x,
+					corner & 2 ? root.boundsMax.y : root.boundsMin.y,
+					corner & 4 ? root.boundsMax.z : root.boundsMin.z));
+			}
+		}
+
+		if (m_MeshInstanceBVH.GetPrimitiveCount() != m_MeshInstances.size())
+			m_MeshInstanceBVHRebuilder.Build(m_MeshInstanceBVH, instanceBounds);
+		else
+			m_MeshInstanceBVHRebuilder.Refit(m_MeshInstanceBVH, instanceBounds);
+
+		if (hasChanged)
+			++m_Version;
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -76,9 +356,21 @@ namespace dae {
 		m.materialIndex = materialIndex;
 
 		m_TriangleMeshGeometries.emplace_back(m);
+		AddMeshInstance(&m_TriangleMeshGeometries.back(), {});
+
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	MeshInstance* Scene::AddMeshInstance(const TriangleMesh* pMesh, const Matrix& transform)
+	{
+		MeshInstance i;
+		i.meshIndex = static_cast<uint32_t>(pMesh - m_TriangleMeshGeometries.data());
+		i.transform = transform;
+
+		m_MeshInstances.emplace_back(i);
+		return &m_MeshInstances.back();
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -102,12 +394,6 @@ namespace dae {
 		m_Lights.emplace_back(l);
 		return &m_Lights.back();
 	}
-
-	unsigned char Scene::AddMaterial(Material* pMaterial)
-	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
-	}
 #pragma endregion
 #pragma endregion
 
@@ -116,11 +402,11 @@ namespace dae {
 	{
 				//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material_SolidColor{ colors::Blue });
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const unsigned char matId_Solid_Green = AddMaterial(Material_SolidColor{ colors::Green });
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -134,4 +420,162 @@ namespace dae {
 		AddPlane({ 0.f, 0.f, 125.f }, { 0.f, 0.f,-1.f }, matId_Solid_Magenta);
 	}
 #pragma endregion
-}
+
+#pragma region SCENE W3
+	void Scene_W3::Initialize()
+	{
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.fovAngle = 45.f;
+
+		const unsigned char matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const unsigned char matLambert_Red = AddMaterial(Material_Lambert(colors::Red, 1.f));
+		const unsigned char matLambert_Yellow = AddMaterial(Material_Lambert(colors::Yellow, 1.f));
+		const unsigned char matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
+
+		//Plane
+		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		//Spheres
+		AddSphere({ -1.75f, 1.f, 0.f }, .75f, matLambert_Red);
+		AddSphere({ 0.f, 1.f, 0.f }, .75f, matLambert_Yellow);
+		AddSphere({ 1.75f, 1.f, 0.f }, .75f, matLambert_White);
+		AddSphere({ -1.75f, 3.f, 0.f }, .75f, matLambert_White);
+		AddSphere({ 0.f, 3.f, 0.f }, .75f, matLambert_Red);
+		AddSphere({ 1.75f, 3.f, 0.f }, .75f, matLambert_Yellow);
+
+		//Light
+		AddPointLight({ 0.f, 5.f, 5.f }, 50.f, { 1.f, .61f, .45f }); //Backlight
+		AddPointLight({ -2.5f, 5.f, -5.f }, 70.f, { 1.f, .8f, .45f }); //Front Light Left
+		AddPointLight({ 2.5f, 2.5f, -5.f }, 50.f, { .34f, .47f, .68f });
+	}
+#pragma endregion
+
+#pragma region SCENE W4
+	void Scene_W4::Initialize()
+	{
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.fovAngle = 45.f;
+
+		const unsigned char matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const unsigned char matLambert_Red = AddMaterial(Material_Lambert(colors::Red, 1.f));
+		const unsigned char matLambert_Yellow = AddMaterial(Material_Lambert(colors::Yellow, 1.f));
+		const unsigned char matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
+
+		//Plane
+		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		//Spheres
+		AddSphere({ -1.75f, 1.f, 0.f }, .75f, matLambert_Red);
+		AddSphere({ 0.f, 1.f, 0.f }, .75f, matLambert_Yellow);
+		AddSphere({ 1.75f, 1.f, 0.f }, .75f, matLambert_White);
+
+		//Triangles, one per cull mode
+		const Triangle baseTriangle{ { -.75f, 1.5f, 0.f }, { .75f, 0.f, 0.f }, { -.75f, 0.f, 0.f } };
+
+		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		m_Meshes[0]->AppendTriangle(baseTriangle);
+		m_Meshes[0]->Translate({ -1.75f, 2.25f, 0.f });
+
+		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
+		m_Meshes[1]->AppendTriangle(baseTriangle);
+		m_Meshes[1]->Translate({ 0.f, 2.25f, 0.f });
+
+		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
+		m_Meshes[2]->AppendTriangle(baseTriangle);
+		m_Meshes[2]->Translate({ 1.75f, 2.25f, 0.f });
+
+		//Light
+		AddPointLight({ 0.f, 5.f, 5.f }, 50.f, { 1.f, .61f, .45f }); //Backlight
+		AddPointLight({ -2.5f, 5.f, -5.f }, 70.f, { 1.f, .8f, .45f }); //Front Light Left
+		AddPointLight({ 2.5f, 2.5f, -5.f }, 50.f, { .34f, .47f, .68f });
+	}
+
+	void Scene_W4::Update(Timer* pTimer)
+	{
+		//Spin the triangles so every side of every cull mode shows up
+		//Only the mesh transform changes, the instance BVH picks it up on the next update
+		const float yawAngle{ (cosf(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
+		for (TriangleMesh* pMesh : m_Meshes)
+		{
+			pMesh->RotateY(yawAngle);
+		}
+
+		Scene::Update(pTimer);
+	}
+#pragma endregion
+
+#pragma region SCENE INSTANCING
+	void Scene_Instancing::Initialize()
+	{
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.fovAngle = 45.f;
+
+		const unsigned char matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const unsigned char matLambert_Yellow = AddMaterial(Material_Lambert(colors::Yellow, 1.f));
+
+		//Plane
+		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		//Pyramid without a base, the mesh's own instance stands in the middle
+		TriangleMesh* pPyramid = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_Yellow);
+		const Vector3 corners[4]{ { -.5f, 0.f, -.5f }, { .5f, 0.f, -.5f }, { .5f, 0.f, .5f }, { -.5f, 0.f, .5f } };
+		for (int cornerIndex{}; cornerIndex < 4; ++cornerIndex)
+		{
+			pPyramid->AppendTriangle({ corners[cornerIndex], { 0.f, 1.f, 0.f }, corners[(cornerIndex + 1) % 4] });
+		}
+
+		//Small copies on a grid around it, they only add a transform each
+		m_Placements.reserve(GRID_SIZE * GRID_SIZE);
+		for (int row{}; row < GRID_SIZE; ++row)
+		{
+			for (int column{}; column < GRID_SIZE; ++column)
+			{
+				Placement placement{};
+				placement.instanceIndex = static_cast<uint32_t>(m_MeshInstances.size());
+				placement.position = { -3.f + 6.f * column / (GRID_SIZE - 1), 0.f, -2.f + 11.f * row / (GRID_SIZE - 1) };
+				placement.yaw = (row + column) * .3f;
+
+				if (std::abs(placement.position.x) < 1.f && std::abs(placement.position.z) < 1.f)
+					continue;
+
+				AddMeshInstance(pPyramid, {});
+				m_Placements.push_back(placement);
+			}
+		}
+
+		//Light
+		AddPointLight({ 0.f, 5.f, 5.f }, 50.f, { 1.f, .61f, .45f }); //Backlight
+		AddPointLight({ -2.5f, 5.f, -5.f }, 70.f, { 1.f, .8f, .45f }); //Front Light Left
+		AddPointLight({ 2.5f, 2.5f, -5.f }, 50.f, { .34f, .47f, .68f });
+	}
+
+	void Scene_Instancing::Update(Timer* pTimer)
+	{
+		//Spin every copy and slide the rows past each other, the shared mesh and its BVH stay untouched
+		//The instance BVH is only refit, sliding rows wear it down until it gets rebuilt in the background
+		const float time{ pTimer->GetTotal() };
+		for (const Placement& placement : m_Placements)
+		{
+			const Vector3 offset{ sinf(time * .5f + placement.position.z) * 1.5f, 0.f, 0.f };
+
+			m_MeshInstances[placement.instanceIndex].transform = Matrix::CreateScale(.3f, .3f, .3f)
+				* Matrix::CreateRotationY(placement.yaw + time)
+				* Matrix::CreateTranslation(placement.position + offset);
+		}
+
+		Scene::Update(pTimer);
+	}
+#pragma endregion
+}
\ No newline at end of file
@@ -5,12 +5,16 @@
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "Material.h"
+#include "BVH.h"
+#include "BVHRebuilder.h"
+#include "RayPacket.h"
+#include "SpherePool.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
@@ -27,20 +31,39 @@ namespace dae
 		Scene& operator=(const Scene&) = delete;
 		Scene& operator=(Scene&&) noexcept = delete;
 
+		//Test scenes by name (W1, W3, W4, Instancing), nullptr for unknown names
+		static Scene* CreateByName(const std::string& sceneName);
+		static std::vector<std::string> GetSceneNames();
+
 		virtual void Initialize() = 0;
 		virtual void Update(dae::Timer* pTimer)
 		{
 			m_Camera.Update(pTimer);
+			UpdateAccelerationStructures();
 		}
 
+		//Rebuilds the BVH when primitives were added, refits it when MarkGeometryMoved was called
+		//Mesh instances are re-placed every call, they only cost a matrix product each
+		//Refit BVHs that degraded too much get rebuilt in the background and swapped in by a later call
+		void UpdateAccelerationStructures();
+		//Goes up whenever UpdateAccelerationStructures sees geometry that was added or moved
+		uint64_t GetVersion() const { return m_Version; }
+
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
-		bool DoesHit(const Ray& ray) const;
+		//Packet version (instantiated for 2x2 and 4x4), traces the lanes one by one when they point in diverging directions
+		template<int Lanes>
+		void GetClosestHit(const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& closestHits) const;
+		//Occlusion query: true as soon as anything is hit within [ray.min, ray.max]
+		//pCache remembers the last occluder, pass the one that belongs to the light the ray is aimed at
+		bool DoesHit(const Ray& ray, OcclusionCache* pCache = nullptr) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
+		const std::vector<MeshInstance>& GetMeshInstances() const { return m_MeshInstances; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const MaterialPool& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
@@ -48,18 +71,58 @@ namespace dae
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		std::vector<MeshInstance> m_MeshInstances{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		MaterialPool m_Materials{};
 
 		Camera m_Camera{};
 
+		//Spheres are bounded and go in the BVH, planes are infinite and are always tested
+		//The pool holds the spheres in BVH leaf order for the SIMD intersection kernels
+		BVH m_SphereBVH{};
+		BVHRebuilder m_SphereBVHRebuilder{};
+		SpherePool m_SpherePool{};
+		bool m_HasGeometryMoved{ false };
+
+		//Call after moving existing spheres so the BVH gets refit before the next frame
+		void MarkGeometryMoved() { m_HasGeometryMoved = true; }
+
+		//Two levels for meshes: the instance BVH holds the world bounds of every instance,
+		//every mesh has its own BVH in mesh space and rays are moved into that space per instance
+		BVH m_MeshInstanceBVH{};
+		BVHRebuilder m_MeshInstanceBVHRebuilder{};
+
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
+		//Also adds one instance of the mesh with an identity transform
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		MeshInstance* AddMeshInstance(const TriangleMesh* pMesh, const Matrix& transform);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		template<typename MaterialT>
+		unsigned char AddMaterial(const MaterialT& material) { return m_Materials.Add(material); }
+
+	private:
+		//Derived from MeshInstance::transform by UpdateAccelerationStructures
+		struct InstanceTransform
+		{
+			Matrix meshToWorld{};
+			Matrix worldToMesh{};
+			Matrix normalToWorld{};
+		};
+		std::vector<InstanceTransform> m_InstanceTransforms{};
+
+		uint64_t m_Version{};
+
+		void UpdateSphereBVH();
+		void UpdateMeshInstanceBVH();
+
+		//Ray versions restore the hit origin and normal to world space, the packet version returns the lanes it hit
+		bool IntersectMeshInstance(uint32_t instanceIndex, const Ray& ray, HitRecord& closestHit) const;
+		template<int Lanes>
+		uint32_t IntersectMeshInstance(uint32_t instanceIndex, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& closestHits) const;
+		bool DoesHitMeshInstance(uint32_t instanceIndex, const Ray& ray) const;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -77,4 +140,68 @@ namespace dae
 
 		void Initialize() override;
 	};
-}
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//WEEK 3 Test Scene (lights and shadows)
+	class Scene_W3 final : public Scene
+	{
+	public:
+		Scene_W3() = default;
+		~Scene_W3() override = default;
+
+		Scene_W3(const Scene_W3&) = delete;
+		Scene_W3(Scene_W3&&) noexcept = delete;
+		Scene_W3& operator=(const Scene_W3&) = delete;
+		Scene_W3& operator=(Scene_W3&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//WEEK 4 Test Scene (triangles and cull modes)
+	class Scene_W4 final : public Scene
+	{
+	public:
+		Scene_W4() = default;
+		~Scene_W4() override = default;
+
+		Scene_W4(const Scene_W4&) = delete;
+		Scene_W4(Scene_W4&&) noexcept = delete;
+		Scene_W4& operator=(const Scene_W4&) = delete;
+		Scene_W4& operator=(Scene_W4&&) noexcept = delete;
+
+		void Initialize() override;
+		void Update(Timer* pTimer) override;
+
+	private:
+		TriangleMesh* m_Meshes[3]{};
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Instancing Test Scene (hundreds of instances sharing one mesh)
+	class Scene_Instancing final : public Scene
+	{
+	public:
+		Scene_Instancing() = default;
+		~Scene_Instancing() override = default;
+
+		Scene_Instancing(const Scene_Instancing&) = delete;
+		Scene_Instancing(Scene_Instancing&&) noexcept = delete;
+		Scene_Instancing& operator=(const Scene_Instancing&) = delete;
+		Scene_Instancing& operator=(Scene_Instancing&&) noexcept = delete;
+
+		void Initialize() override;
+		void Update(Timer* pTimer) override;
+
+	private:
+		static constexpr int GRID_SIZE{ 20 };
+
+		struct Placement
+		{
+			uint32_t instanceIndex{};
+			Vector3 position{};
+			float yaw{};
+		};
+		std::vector<Placement> m_Placements{};
+	};
+}
\ No newline at end of file
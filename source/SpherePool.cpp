@@ -0,0 +1,345 @@
+#include "SpherePool.h"
+
+#include <bit>
+
+#include "RayStats.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Ray terms shared by every sphere, precomputed the same way GeometryUtils::HitTest_Sphere computes them
+		struct SphereRay
+		{
+			Vector3 origin{};
+			Vector3 doubleDirection{};
+			float a{};
+			float fourA{};
+			float minT{};
+		};
+
+		struct SphereLanes
+		{
+			const float* pOriginX{};
+			const float* pOriginY{};
+			const float* pOriginZ{};
+			const float* pRadius{};
+		};
+
+		SphereRay MakeSphereRay(const Ray& ray)
+		{
+			SphereRay sphereRay{};
+			sphereRay.origin = ray.origin;
+			sphereRay.doubleDirection = 2 * ray.direction;
+			sphereRay.a = Vector3::Dot(ray.direction, ray.direction);
+			sphereRay.fourA = 4 * sphereRay.a;
+			sphereRay.minT = ray.min;
+			return sphereRay;
+		}
+
+#pragma region Scalar
+		//Returns FLT_MAX on a miss
+		inline float IntersectLane_Scalar(const SphereLanes& lanes, uint32_t index, const SphereRay& ray)
+		{
+			const float ocX{ ray.origin.x - lanes.pOriginX[index] };
+			const float ocY{ ray.origin.y - lanes.pOriginY[index] };
+			const float ocZ{ ray.origin.z - lanes.pOriginZ[index] };
+			const float radius{ lanes.pRadius[index] };
+
+			const float b{ ray.doubleDirection.x * ocX + ray.doubleDirection.y * ocY + ray.doubleDirection.z * ocZ };
+			const float c{ ocX * ocX + ocY * ocY + ocZ * ocZ - radius * radius };
+			const float discriminant{ b * b - ray.fourA * c };
+			if (!(discriminant > 0))
+				return FLT_MAX;
+
+			const float t{ (-b - sqrtf(discriminant)) / 2 * ray.a };
+			return t >= ray.minT ? t : FLT_MAX;
+		}
+
+		bool FindClosest_Scalar(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex, float& hitT)
+		{
+			bool didHit{ false };
+			for (uint32_t index{ first }; index < first + count; ++index)
+			{
+				const float t{ IntersectLane_Scalar(lanes, index, ray) };
+				if (t != FLT_MAX && t <= maxT)
+				{
+					maxT = t;
+					hitT = t;
+					hitIndex = index;
+					didHit = true;
+				}
+			}
+			return didHit;
+		}
+
+		bool FindAny_Scalar(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex)
+		{
+			for (uint32_t index{ first }; index < first + count; ++index)
+			{
+				if (IntersectLane_Scalar(lanes, index, ray) <= maxT)
+				{
+					hitIndex = index;
+					return true;
+				}
+			}
+			return false;
+		}
+#pragma endregion
+
+#if DAE_SIMD_X64
+#pragma region AVX2
+		//Bitmask of the lanes in [base, base + 8) that hit within [ray.min, maxT], t written per lane
+		DAE_TARGET_AVX2 inline uint32_t IntersectLanes_AVX2(const SphereLanes& lanes, uint32_t base, uint32_t remaining, const SphereRay& ray, float maxT, float t[8])
+		{
+			const __m256 signMask{ _mm256_set1_ps(-0.f) };
+
+			const __m256 ocX{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_loadu_ps(lanes.pOriginX + base)) };
+			const __m256 ocY{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_loadu_ps(lanes.pOriginY + base)) };
+			const __m256 ocZ{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_loadu_ps(lanes.pOriginZ + base)) };
+			const __m256 radius{ _mm256_loadu_ps(lanes.pRadius + base) };
+
+			const __m256 b{ _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_set1_ps(ray.doubleDirection.x), ocX),
+				_mm256_mul_ps(_mm256_set1_ps(ray.doubleDirection.y), ocY)),
+				_mm256_mul_ps(_mm256_set1_ps(ray.doubleDirection.z), ocZ)) };
+			const __m256 c{ _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(ocX, ocX),
+				_mm256_mul_ps(ocY, ocY)),
+				_mm256_mul_ps(ocZ, ocZ)),
+				_mm256_mul_ps(radius, radius)) };
+			const __m256 discriminant{ _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_set1_ps(ray.fourA), c)) };
+
+			const __m256 negativeB{ _mm256_xor_ps(b, signMask) };
+			const __m256 tLanes{ _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(negativeB, _mm256_sqrt_ps(discriminant)), _mm256_set1_ps(0.5f)), _mm256_set1_ps(ray.a)) };
+
+			__m256 hitMask{ _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GT_OQ) };
+			hitMask = _mm256_and_ps(hitMask, _mm256_cmp_ps(tLanes, _mm256_set1_ps(ray.minT), _CMP_GE_OQ));
+			hitMask = _mm256_and_ps(hitMask, _mm256_cmp_ps(tLanes, _mm256_set1_ps(maxT), _CMP_LE_OQ));
+
+			_mm256_storeu_ps(t, tLanes);
+
+			uint32_t bits{ static_cast<uint32_t>(_mm256_movemask_ps(hitMask)) };
+			if (remaining < 8)
+				bits &= (1u << remaining) - 1;
+			return bits;
+		}
+
+		DAE_TARGET_AVX2 bool FindClosest_AVX2(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex, float& hitT)
+		{
+			bool didHit{ false };
+			alignas(32) float t[8];
+			for (uint32_t base{ first }; base < first + count; base += 8)
+			{
+				uint32_t bits{ IntersectLanes_AVX2(lanes, base, first + count - base, ray, maxT, t) };
+
+				//Walk the hit lanes in order, matching the sequential "t <= closest" of the scalar path
+				while (bits != 0)
+				{
+					const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(bits)) };
+					bits &= bits - 1;
+					if (t[lane] <= maxT)
+					{
+						maxT = t[lane];
+						hitT = t[lane];
+						hitIndex = base + lane;
+						didHit = true;
+					}
+				}
+			}
+			return didHit;
+		}
+
+		DAE_TARGET_AVX2 bool FindAny_AVX2(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex)
+		{
+			alignas(32) float t[8];
+			for (uint32_t base{ first }; base < first + count; base += 8)
+			{
+				const uint32_t bits{ IntersectLanes_AVX2(lanes, base, first + count - base, ray, maxT, t) };
+				if (bits != 0)
+				{
+					hitIndex = base + static_cast<uint32_t>(std::countr_zero(bits));
+					return true;
+				}
+			}
+			return false;
+		}
+#pragma endregion
+
+#pragma region AVX512
+		DAE_TARGET_AVX512 inline uint32_t IntersectLanes_AVX512(const SphereLanes& lanes, uint32_t base, uint32_t remaining, const SphereRay& ray, float maxT, float t[16])
+		{
+			const __m512i signMask{ _mm512_set1_epi32(static_cast<int>(0x80000000)) };
+
+			const __m512 ocX{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.x), _mm512_loadu_ps(lanes.pOriginX + base)) };
+			const __m512 ocY{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.y), _mm512_loadu_ps(lanes.pOriginY + base)) };
+			const __m512 ocZ{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.z), _mm512_loadu_ps(lanes.pOriginZ + base)) };
+			const __m512 radius{ _mm512_loadu_ps(lanes.pRadius + base) };
+
+			const __m512 b{ _mm512_add_ps(_mm512_add_ps(
+				_mm512_mul_ps(_mm512_set1_ps(ray.doubleDirection.x), ocX),
+				_mm512_mul_ps(_mm512_set1_ps(ray.doubleDirection.y), ocY)),
+				_mm512_mul_ps(_mm512_set1_ps(ray.doubleDirection.z), ocZ)) };
+			const __m512 c{ _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(
+				_mm512_mul_ps(ocX, ocX),
+				_mm512_mul_ps(ocY, ocY)),
+				_mm512_mul_ps(ocZ, ocZ)),
+				_mm512_mul_ps(radius, radius)) };
+			const __m512 discriminant{ _mm512_sub_ps(_mm512_mul_ps(b, b), _mm512_mul_ps(_mm512_set1_ps(ray.fourA), c)) };
+
+			const __m512 negativeB{ _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(b), signMask)) };
+			const __m512 tLanes{ _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(negativeB, _mm512_sqrt_ps(discriminant)), _mm512_set1_ps(0.5f)), _mm512_set1_ps(ray.a)) };
+
+			__mmask16 hitMask{ _mm512_cmp_ps_mask(discriminant, _mm512_setzero_ps(), _CMP_GT_OQ) };
+			hitMask &= _mm512_cmp_ps_mask(tLanes, _mm512_set1_ps(ray.minT), _CMP_GE_OQ);
+			hitMask &= _mm512_cmp_ps_mask(tLanes, _mm512_set1_ps(maxT), _CMP_LE_OQ);
+
+			_mm512_storeu_ps(t, tLanes);
+
+			uint32_t bits{ hitMask };
+			if (remaining < 16)
+				bits &= (1u << remaining) - 1;
+			return bits;
+		}
+
+		DAE_TARGET_AVX512 bool FindClosest_AVX512(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex, float& hitT)
+		{
+			bool didHit{ false };
+			alignas(64) float t[16];
+			for (uint32_t base{ first }; base < first + count; base += 16)
+			{
+				uint32_t bits{ IntersectLanes_AVX512(lanes, base, first + count - base, ray, maxT, t) };
+				while (bits != 0)
+				{
+					const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(bits)) };
+					bits &= bits - 1;
+					if (t[lane] <= maxT)
+					{
+						maxT = t[lane];
+						hitT = t[lane];
+						hitIndex = base + lane;
+						didHit = true;
+					}
+				}
+			}
+			return didHit;
+		}
+
+		DAE_TARGET_AVX512 bool FindAny_AVX512(const SphereLanes& lanes, uint32_t first, uint32_t count, const SphereRay& ray, float maxT, uint32_t& hitIndex)
+		{
+			alignas(64) float t[16];
+			for (uint32_t base{ first }; base < first + count; base += 16)
+			{
+				const uint32_t bits{ IntersectLanes_AVX512(lanes, base, first + count - base, ray, maxT, t) };
+				if (bits != 0)
+				{
+					hitIndex = base + static_cast<uint32_t>(std::countr_zero(bits));
+					return true;
+				}
+			}
+			return false;
+		}
+#pragma endregion
+#endif
+	}
+
+	SpherePool::SpherePool() :
+		m_InstructionSet(SIMD::GetInstructionSet())
+	{
+	}
+
+	void SpherePool::Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order)
+	{
+		m_Size = static_cast<uint32_t>(order.size());
+
+		//Padding lanes are zero-sized spheres at the origin, they are masked out before any result is used
+		const size_t paddedSize{ m_Size + size_t(PADDING) };
+		m_OriginX.assign(paddedSize, 0.f);
+		m_OriginY.assign(paddedSize, 0.f);
+		m_OriginZ.assign(paddedSize, 0.f);
+		m_Radius.assign(paddedSize, 0.f);
+		m_MaterialIndices.assign(paddedSize, 0);
+
+		for (uint32_t index{}; index < m_Size; ++index)
+		{
+			const Sphere& sphere{ spheres[order[index]] };
+			m_OriginX[index] = sphere.origin.x;
+			m_OriginY[index] = sphere.origin.y;
+			m_OriginZ[index] = sphere.origin.z;
+			m_Radius[index] = sphere.radius;
+			m_MaterialIndices[index] = sphere.materialIndex;
+		}
+	}
+
+	uint32_t SpherePool::GetLaneCount() const
+	{
+		switch (m_InstructionSet)
+		{
+		case SIMD::InstructionSet::AVX2:
+			return 8;
+		case SIMD::InstructionSet::AVX512:
+			return 16;
+		default:
+			return 1;
+		}
+	}
+
+	bool SpherePool::IntersectClosest(uint32_t first, uint32_t count, const Ray& ray, HitRecord& hitRecord) const
+	{
+		DAE_COUNT_RAYS(SphereTests, count);
+
+		const SphereLanes lanes{ m_OriginX.data(), m_OriginY.data(), m_OriginZ.data(), m_Radius.data() };
+		const SphereRay sphereRay{ MakeSphereRay(ray) };
+
+		uint32_t hitIndex{};
+		float hitT{};
+		bool didHit{};
+		switch (m_InstructionSet)
+		{
+#if DAE_SIMD_X64
+		case SIMD::InstructionSet::AVX2:
+			didHit = FindClosest_AVX2(lanes, first, count, sphereRay, hitRecord.t, hitIndex, hitT);
+			break;
+		case SIMD::InstructionSet::AVX512:
+			didHit = FindClosest_AVX512(lanes, first, count, sphereRay, hitRecord.t, hitIndex, hitT);
+			break;
+#endif
+		default:
+			didHit = FindClosest_Scalar(lanes, first, count, sphereRay, hitRecord.t, hitIndex, hitT);
+			break;
+		}
+
+		if (!didHit)
+			return false;
+
+		const Vector3 sphereOrigin{ m_OriginX[hitIndex], m_OriginY[hitIndex], m_OriginZ[hitIndex] };
+
+		hitRecord.t = hitT;
+		hitRecord.didHit = true;
+		hitRecord.origin = ray.origin + ray.direction * hitT;
+		hitRecord.normal = (hitRecord.origin - sphereOrigin) / m_Radius[hitIndex];
+		hitRecord.materialIndex = m_MaterialIndices[hitIndex];
+		return true;
+	}
+
+	bool SpherePool::IntersectAny(uint32_t first, uint32_t count, const Ray& ray, uint32_t& hitIndex) const
+	{
+		//The whole range, even when an early sphere already occludes
+		DAE_COUNT_RAYS(SphereTests, count);
+
+		const SphereLanes lanes{ m_OriginX.data(), m_OriginY.data(), m_OriginZ.data(), m_Radius.data() };
+		const SphereRay sphereRay{ MakeSphereRay(ray) };
+
+		switch (m_InstructionSet)
+		{
+#if DAE_SIMD_X64
+		case SIMD::InstructionSet::AVX2:
+			return FindAny_AVX2(lanes, first, count, sphereRay, ray.max, hitIndex);
+		case SIMD::InstructionSet::AVX512:
+			return FindAny_AVX512(lanes, first, count, sphereRay, ray.max, hitIndex);
+#endif
+		default:
+			return FindAny_Scalar(lanes, first, count, sphereRay, ray.max, hitIndex);
+		}
+	}
+}
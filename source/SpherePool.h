@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	//Structure-of-arrays copy of the scene spheres, laid out in BVH leaf order
+	//A BVH leaf covers a contiguous range, so one ray is tested against 8 (AVX2) or 16 (AVX-512) spheres per instruction.
+	//Every array is padded past the last sphere so a full vector load at the end of a range stays in bounds.
+	class SpherePool final
+	{
+	public:
+		SpherePool();
+		~SpherePool() = default;
+
+		static constexpr uint32_t PADDING{ 16 };
+
+		//order[i] is the index in spheres of the i-th sphere in the pool
+		void Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order);
+
+		uint32_t GetSize() const { return m_Size; }
+		//Number of spheres one kernel call tests at once, useful as BVH leaf batch size
+		uint32_t GetLaneCount() const;
+
+		//Overrides the detected instruction set, e.g. to force the scalar fallback
+		void SetInstructionSet(SIMD::InstructionSet instructionSet) { m_InstructionSet = instructionSet; }
+		SIMD::InstructionSet GetInstructionSet() const { return m_InstructionSet; }
+
+		//Closest hit in [first, first + count) within [ray.min, hitRecord.t], same results as GeometryUtils::HitTest_Sphere
+		bool IntersectClosest(uint32_t first, uint32_t count, const Ray& ray, HitRecord& hitRecord) const;
+		//True if any sphere in [first, first + count) is hit within [ray.min, ray.max], hitIndex is the first one found
+		bool IntersectAny(uint32_t first, uint32_t count, const Ray& ray, uint32_t& hitIndex) const;
+
+	private:
+		std::vector<float> m_OriginX{};
+		std::vector<float> m_OriginY{};
+		std::vector<float> m_OriginZ{};
+		std::vector<float> m_Radius{};
+		std::vector<unsigned char> m_MaterialIndices{};
+		uint32_t m_Size{};
+
+		SIMD::InstructionSet m_InstructionSet{ SIMD::InstructionSet::Scalar };
+	};
+}
@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+{
+	if (numThreads == 0)
+		numThreads = GetDefaultThreadCount();
+
+	m_Queues.reserve(numThreads);
+	for (uint32_t queueIndex{}; queueIndex < numThreads; ++queueIndex)
+	{
+		m_Queues.emplace_back(std::make_unique<WorkQueue>());
+	}
+
+	//Queue 0 belongs to the calling thread
+	m_Workers.reserve(numThreads - 1);
+	for (uint32_t queueIndex{ 1 }; queueIndex < numThreads; ++queueIndex)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, queueIndex);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsShuttingDown = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t ThreadPool::GetDefaultThreadCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ThreadPool::ParallelFor(uint32_t numTasks, const std::function<void(uint32_t)>& task)
+{
+	if (numTasks == 0)
+		return;
+
+	if (m_Workers.empty() || numTasks == 1)
+	{
+		for (uint32_t taskIndex{}; taskIndex < numTasks; ++taskIndex)
+		{
+			task(taskIndex);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard lock{ m_Mutex };
+
+		//Publish the task before filling the queues, a worker still busy from the last call may pick it up right away
+		m_pTask = &task;
+		m_TasksRemaining = numTasks;
+
+		//Hand out contiguous ranges so neighbouring tasks start out on the same worker
+		const uint32_t numQueues{ static_cast<uint32_t>(m_Queues.size()) };
+		for (uint32_t queueIndex{}; queueIndex < numQueues; ++queueIndex)
+		{
+			const uint32_t first{ static_cast<uint32_t>(uint64_t(numTasks) * queueIndex / numQueues) };
+			const uint32_t last{ static_cast<uint32_t>(uint64_t(numTasks) * (queueIndex + 1) / numQueues) };
+
+			WorkQueue& queue{ *m_Queues[queueIndex] };
+			std::lock_guard queueLock{ queue.mutex };
+			for (uint32_t taskIndex{ first }; taskIndex < last; ++taskIndex)
+			{
+				queue.tasks.push_back(taskIndex);
+			}
+		}
+
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	RunTasks(0);
+
+	std::unique_lock lock{ m_Mutex };
+	m_DoneCondition.wait(lock, [this] { return m_TasksRemaining == 0 && m_BusyWorkers == 0; });
+	m_pTask = nullptr;
+}
+
+void ThreadPool::WorkerLoop(uint32_t queueIndex)
+{
+	uint64_t lastGeneration{};
+
+	while (true)
+	{
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_WakeCondition.wait(lock, [&] { return m_IsShuttingDown || m_Generation != lastGeneration; });
+
+			if (m_IsShuttingDown)
+				return;
+
+			lastGeneration = m_Generation;
+			++m_BusyWorkers;
+		}
+
+		RunTasks(queueIndex);
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			--m_BusyWorkers;
+		}
+		m_DoneCondition.notify_all();
+	}
+}
+
+void ThreadPool::RunTasks(uint32_t queueIndex)
+{
+	uint32_t taskIndex{};
+	while (PopTask(queueIndex, taskIndex) || StealTask(queueIndex, taskIndex))
+	{
+		(*m_pTask)(taskIndex);
+
+		if (--m_TasksRemaining == 0)
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_DoneCondition.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::PopTask(uint32_t queueIndex, uint32_t& task)
+{
+	WorkQueue& queue{ *m_Queues[queueIndex] };
+	std::lock_guard lock{ queue.mutex };
+	if (queue.tasks.empty())
+		return false;
+
+	task = queue.tasks.front();
+	queue.tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::StealTask(uint32_t thiefIndex, uint32_t& task)
+{
+	const uint32_t numQueues{ static_cast<uint32_t>(m_Queues.size()) };
+	for (uint32_t offset{ 1 }; offset < numQueues; ++offset)
+	{
+		WorkQueue& victim{ *m_Queues[(thiefIndex + offset) % numQueues] };
+		std::lock_guard lock{ victim.mutex };
+		if (victim.tasks.empty())
+			continue;
+
+		//Steal from the back, the owner keeps working through the front
+		task = victim.tasks.back();
+		victim.tasks.pop_back();
+		return true;
+	}
+	return false;
+}
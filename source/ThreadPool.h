@@ -0,0 +1,62 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//Persistent worker pool
+	//Every worker owns a task queue and steals from the back of the other queues once its own runs dry.
+	//The thread calling ParallelFor works along as worker 0, so a pool of 1 thread runs everything inline.
+	class ThreadPool final
+	{
+	public:
+		explicit ThreadPool(uint32_t numThreads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		//Runs task(index) for every index in [0, numTasks) and returns once all of them are done
+		void ParallelFor(uint32_t numTasks, const std::function<void(uint32_t)>& task);
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+		static uint32_t GetDefaultThreadCount();
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex mutex{};
+			std::deque<uint32_t> tasks{};
+		};
+
+		void WorkerLoop(uint32_t queueIndex);
+		void RunTasks(uint32_t queueIndex);
+		bool PopTask(uint32_t queueIndex, uint32_t& task);
+		bool StealTask(uint32_t thiefIndex, uint32_t& task);
+
+		std::vector<std::thread> m_Workers{};
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const std::function<void(uint32_t)>* m_pTask{};
+		std::atomic<uint32_t> m_TasksRemaining{};
+		uint64_t m_Generation{};
+		uint32_t m_BusyWorkers{};
+		bool m_IsShuttingDown{ false };
+	};
+}
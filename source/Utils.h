@@ -1,8 +1,13 @@
 #pragma once
+#include <bit>
 #include <cassert>
+#include <cmath>
 #include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "OBJLoader.h"
+#include "RayPacket.h"
+#include "RayStats.h"
 
 namespace dae
 {
@@ -13,6 +18,7 @@ namespace dae
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			//todo W1
+			DAE_COUNT_RAYS(SphereTests, 1);
 			const Vector3 fromSphereToRayOrigin{  ray.origin - sphere.origin };
 
 			const float a{ Vector3::Dot(ray.direction, ray.direction) };
@@ -25,7 +31,7 @@ namespace dae
 			
 			if(isHit)
 			{
-				const float squareRoot{ sqrt(discriminant) };
+				const float squareRoot{ std::sqrt(discriminant) };
 
 				float t{ (-b - squareRoot) / 2 * a };
 
@@ -46,10 +52,23 @@ namespace dae
 
 		}
 
+		//Occlusion test: any hit within [ray.min, ray.max], no hit attributes are computed
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Sphere(sphere, ray, temp, true);
+			DAE_COUNT_RAYS(SphereTests, 1);
+
+			const Vector3 fromSphereToRayOrigin{ ray.origin - sphere.origin };
+
+			const float a{ Vector3::Dot(ray.direction, ray.direction) };
+			const float b{ Vector3::Dot(2 * ray.direction, fromSphereToRayOrigin) };
+			const float c{ Vector3::Dot(fromSphereToRayOrigin, fromSphereToRayOrigin) - sphere.radius * sphere.radius };
+
+			const float discriminant{ b * b - 4 * a * c };
+			if (discriminant <= 0)
+				return false;
+
+			const float t{ (-b - sqrtf(discriminant)) / 2 * a };
+			return t >= ray.min && t <= ray.max;
 		}
 #pragma endregion
 #pragma region Plane HitTest
@@ -57,6 +76,7 @@ namespace dae
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			//todo W1
+			DAE_COUNT_RAYS(PlaneTests, 1);
 			//const Vector3 fromRayToPlaneOrigin{  };
 
 			const float t{ Vector3::Dot(plane.origin - ray.origin, plane.normal) / Vector3::Dot(ray.direction, plane.normal) };
@@ -69,135 +89,400 @@ namespace dae
 					hitRecord.t = t;
 					hitRecord.didHit = true;
 					hitRecord.origin = ray.origin + ray.direction * t;
+					hitRecord.normal = plane.normal;
 					hitRecord.materialIndex = plane.materialIndex;
 				}
 				return true;
 			}
 		}
 
+		//Occlusion test: any hit within [ray.min, ray.max], no hit attributes are computed
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			DAE_COUNT_RAYS(PlaneTests, 1);
+
+			const float t{ Vector3::Dot(plane.origin - ray.origin, plane.normal) / Vector3::Dot(ray.direction, plane.normal) };
+			return t >= ray.min && t <= ray.max;
 		}
 #pragma endregion
 #pragma region Triangle HitTest
 		//TRIANGLE HIT-TESTS
+		//Möller–Trumbore, returns the distance in t without touching a hit record
+		//Culling looks at the stored normal: back faces point away from the ray origin (normal and direction agree)
+		//Occlusion tests look from the surface towards the light, i.e. at the other side, so they cull the opposite face
+		inline bool HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector3& normal, TriangleCullMode cullMode,
+			const Ray& ray, float maxT, float& t, bool isOcclusionTest = false)
+		{
+			DAE_COUNT_RAYS(TriangleTests, 1);
+
+			const float normalDotDirection{ Vector3::Dot(normal, ray.direction) };
+			if (normalDotDirection == 0.f)
+				return false;
+
+			const bool isBackFace{ (normalDotDirection > 0.f) != isOcclusionTest };
+			if ((cullMode == TriangleCullMode::BackFaceCulling && isBackFace)
+				|| (cullMode == TriangleCullMode::FrontFaceCulling && !isBackFace))
+				return false;
+
+			const Vector3 edgeV0V1{ v1 - v0 };
+			const Vector3 edgeV0V2{ v2 - v0 };
+
+			const Vector3 p{ Vector3::Cross(ray.direction, edgeV0V2) };
+			const float determinant{ Vector3::Dot(edgeV0V1, p) };
+			if (determinant == 0.f)
+				return false;
+
+			const float inverseDeterminant{ 1.f / determinant };
+
+			const Vector3 fromV0ToRayOrigin{ ray.origin - v0 };
+			const float u{ Vector3::Dot(fromV0ToRayOrigin, p) * inverseDeterminant };
+			if (u < 0.f || u > 1.f)
+				return false;
+
+			const Vector3 q{ Vector3::Cross(fromV0ToRayOrigin, edgeV0V1) };
+			const float v{ Vector3::Dot(ray.direction, q) * inverseDeterminant };
+			if (v < 0.f || u + v > 1.f)
+				return false;
+
+			t = Vector3::Dot(edgeV0V2, q) * inverseDeterminant;
+			return t >= ray.min && t <= maxT;
+		}
+
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			//todo W5
-			assert(false && "No Implemented Yet!");
-			return false;
+			float t{};
+			if (!HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.normal, triangle.cullMode, ray, hitRecord.t, t, ignoreHitRecord))
+				return false;
+
+			if (!ignoreHitRecord)
+			{
+				hitRecord.t = t;
+				hitRecord.didHit = true;
+				hitRecord.origin = ray.origin + ray.direction * t;
+				hitRecord.normal = triangle.normal;
+				hitRecord.materialIndex = triangle.materialIndex;
+			}
+			return true;
 		}
 
+		//Occlusion test: any hit within [ray.min, ray.max], no hit attributes are computed
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Triangle(triangle, ray, temp, true);
+			float t{};
+			return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.normal, triangle.cullMode, ray, ray.max, t, true);
 		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
+		//Tests triangle triangleIndex of the mesh, ray in mesh space
+		inline bool HitTest_MeshTriangle(const TriangleMesh& mesh, uint32_t triangleIndex, const Ray& ray, float maxT, float& t, bool isOcclusionTest = false)
+		{
+			const int* pIndices{ &mesh.indices[triangleIndex * 3] };
+			return HitTest_Triangle(mesh.positions[pIndices[0]], mesh.positions[pIndices[1]], mesh.positions[pIndices[2]],
+				mesh.normals[triangleIndex], mesh.cullMode, ray, maxT, t, isOcclusionTest);
+		}
+
+		//Walks the mesh BVH, so only the triangles in leaves the ray reaches are tested
+		//The ray is in mesh space (untransformed positions) and so are the hit origin and normal
+		//Leave the ray direction unnormalized after transforming it, t then stays the same in both spaces
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			//todo W5
-			assert(false && "No Implemented Yet!");
-			return false;
+			const auto& triangleIndices = mesh.bvh.GetPrimitiveIndices();
+
+			if (ignoreHitRecord)
+			{
+				Ray occlusionRay{ ray };
+				occlusionRay.max = std::min(ray.max, hitRecord.t);
+
+				return mesh.bvh.IntersectAny(occlusionRay, [&](uint32_t first, uint32_t count)
+					{
+						float t{};
+						for (uint32_t index{ first }; index < first + count; ++index)
+						{
+							if (HitTest_MeshTriangle(mesh, triangleIndices[index], occlusionRay, occlusionRay.max, t, true))
+								return true;
+						}
+						return false;
+					});
+			}
+
+			uint32_t closestTriangle{ UINT32_MAX };
+			float closestT{ hitRecord.t };
+			mesh.bvh.Intersect(ray, closestT, [&](uint32_t first, uint32_t count)
+				{
+					float t{};
+					for (uint32_t index{ first }; index < first + count; ++index)
+					{
+						if (HitTest_MeshTriangle(mesh, triangleIndices[index], ray, closestT, t))
+						{
+							closestT = t;
+							closestTriangle = triangleIndices[index];
+						}
+					}
+				});
+
+			if (closestTriangle == UINT32_MAX)
+				return false;
+
+			//Hit attributes only for the closest triangle, not for every triangle that got closer along the way
+			hitRecord.t = closestT;
+			hitRecord.didHit = true;
+			hitRecord.origin = ray.origin + ray.direction * closestT;
+			hitRecord.normal = mesh.normals[closestTriangle];
+			hitRecord.materialIndex = mesh.materialIndex;
+			return true;
 		}
 
+		//Occlusion test: any hit within [ray.min, ray.max], no hit attributes are computed
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
 			HitRecord temp{};
 			return HitTest_TriangleMesh(mesh, ray, temp, true);
 		}
+#pragma endregion
+#pragma region Packet HitTests
+		//PACKET HIT-TESTS
+		//Same math as the single ray tests, evaluated for every lane and only kept for active lanes that hit closer
+		//Returns the mask of lanes whose hit record was updated
+		template<int Lanes>
+		inline uint32_t HitTest_Sphere(const Sphere& sphere, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& hitRecord)
+		{
+			DAE_COUNT_RAYS(SphereTests, std::popcount(packet.activeMask));
+
+			const Vector3 fromSphereToRayOrigin{ packet.origin - sphere.origin };
+			const float c{ Vector3::Dot(fromSphereToRayOrigin, fromSphereToRayOrigin) - sphere.radius * sphere.radius };
+
+			alignas(64) float tLanes[Lanes];
+			bool isHit[Lanes];
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				const float dx{ packet.directionX[lane] };
+				const float dy{ packet.directionY[lane] };
+				const float dz{ packet.directionZ[lane] };
+
+				const float a{ dx * dx + dy * dy + dz * dz };
+				const float b{ (2 * dx) * fromSphereToRayOrigin.x + (2 * dy) * fromSphereToRayOrigin.y + (2 * dz) * fromSphereToRayOrigin.z };
+				const float discriminant{ b * b - 4 * a * c };
+
+				tLanes[lane] = (-b - sqrtf(std::max(discriminant, 0.f))) / 2 * a;
+				isHit[lane] = discriminant > 0 && tLanes[lane] >= packet.min && tLanes[lane] <= hitRecord.t[lane];
+			}
+
+			uint32_t hitMask{};
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				hitMask |= uint32_t(isHit[lane]) << lane;
+			}
+			hitMask &= packet.activeMask;
+
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				if (!((hitMask >> lane) & 1))
+					continue;
+
+				const float t{ tLanes[lane] };
+				hitRecord.t[lane] = t;
+				hitRecord.originX[lane] = packet.origin.x + packet.directionX[lane] * t;
+				hitRecord.originY[lane] = packet.origin.y + packet.directionY[lane] * t;
+				hitRecord.originZ[lane] = packet.origin.z + packet.directionZ[lane] * t;
+				hitRecord.normalX[lane] = (hitRecord.originX[lane] - sphere.origin.x) / sphere.radius;
+				hitRecord.normalY[lane] = (hitRecord.originY[lane] - sphere.origin.y) / sphere.radius;
+				hitRecord.normalZ[lane] = (hitRecord.originZ[lane] - sphere.origin.z) / sphere.radius;
+				hitRecord.materialIndex[lane] = sphere.materialIndex;
+			}
+			hitRecord.hitMask |= hitMask;
+			return hitMask;
+		}
+
+		template<int Lanes>
+		inline uint32_t HitTest_Plane(const Plane& plane, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& hitRecord)
+		{
+			DAE_COUNT_RAYS(PlaneTests, std::popcount(packet.activeMask));
+
+			const float numerator{ Vector3::Dot(plane.origin - packet.origin, plane.normal) };
+
+			alignas(64) float tLanes[Lanes];
+			bool isHit[Lanes];
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				const float denominator{ packet.directionX[lane] * plane.normal.x + packet.directionY[lane] * plane.normal.y + packet.directionZ[lane] * plane.normal.z };
+				tLanes[lane] = numerator / denominator;
+				isHit[lane] = !(tLanes[lane] < packet.min || tLanes[lane] > hitRecord.t[lane]);
+			}
+
+			uint32_t hitMask{};
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				hitMask |= uint32_t(isHit[lane]) << lane;
+			}
+			hitMask &= packet.activeMask;
+
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				if (!((hitMask >> lane) & 1))
+					continue;
+
+				const float t{ tLanes[lane] };
+				hitRecord.t[lane] = t;
+				hitRecord.originX[lane] = packet.origin.x + packet.directionX[lane] * t;
+				hitRecord.originY[lane] = packet.origin.y + packet.directionY[lane] * t;
+				hitRecord.originZ[lane] = packet.origin.z + packet.directionZ[lane] * t;
+				hitRecord.normalX[lane] = plane.normal.x;
+				hitRecord.normalY[lane] = plane.normal.y;
+				hitRecord.normalZ[lane] = plane.normal.z;
+				hitRecord.materialIndex[lane] = plane.materialIndex;
+			}
+			hitRecord.hitMask |= hitMask;
+			return hitMask;
+		}
+
+		//Culling uses the same rules as the single ray test, evaluated per lane
+		template<int Lanes>
+		inline uint32_t HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector3& normal, TriangleCullMode cullMode,
+			unsigned char materialIndex, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& hitRecord)
+		{
+			DAE_COUNT_RAYS(TriangleTests, std::popcount(packet.activeMask));
+
+			const Vector3 edgeV0V1{ v1 - v0 };
+			const Vector3 edgeV0V2{ v2 - v0 };
+
+			//The packet shares its origin, so everything that only depends on it is computed once
+			const Vector3 fromV0ToRayOrigin{ packet.origin - v0 };
+			const Vector3 q{ Vector3::Cross(fromV0ToRayOrigin, edgeV0V1) };
+			const float qDotEdgeV0V2{ Vector3::Dot(edgeV0V2, q) };
+
+			alignas(64) float tLanes[Lanes];
+			bool isHit[Lanes];
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				const float dx{ packet.directionX[lane] };
+				const float dy{ packet.directionY[lane] };
+				const float dz{ packet.directionZ[lane] };
+
+				const float normalDotDirection{ normal.x * dx + normal.y * dy + normal.z * dz };
+				const bool isBackFace{ normalDotDirection > 0.f };
+				const bool isCulled{ normalDotDirection == 0.f
+					|| (cullMode == TriangleCullMode::BackFaceCulling && isBackFace)
+					|| (cullMode == TriangleCullMode::FrontFaceCulling && !isBackFace) };
+
+				//p = direction x edgeV0V2
+				const float px{ dy * edgeV0V2.z - dz * edgeV0V2.y };
+				const float py{ dz * edgeV0V2.x - dx * edgeV0V2.z };
+				const float pz{ dx * edgeV0V2.y - dy * edgeV0V2.x };
+
+				const float determinant{ edgeV0V1.x * px + edgeV0V1.y * py + edgeV0V1.z * pz };
+				const float inverseDeterminant{ 1.f / determinant };
+
+				const float u{ (fromV0ToRayOrigin.x * px + fromV0ToRayOrigin.y * py + fromV0ToRayOrigin.z * pz) * inverseDeterminant };
+				const float v{ (dx * q.x + dy * q.y + dz * q.z) * inverseDeterminant };
+
+				tLanes[lane] = qDotEdgeV0V2 * inverseDeterminant;
+				isHit[lane] = !isCulled && determinant != 0.f
+					&& u >= 0.f && u <= 1.f && v >= 0.f && u + v <= 1.f
+					&& tLanes[lane] >= packet.min && tLanes[lane] <= hitRecord.t[lane];
+			}
+
+			uint32_t hitMask{};
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				hitMask |= uint32_t(isHit[lane]) << lane;
+			}
+			hitMask &= packet.activeMask;
+
+			for (int lane{}; lane < Lanes; ++lane)
+			{
+				if (!((hitMask >> lane) & 1))
+					continue;
+
+				const float t{ tLanes[lane] };
+				hitRecord.t[lane] = t;
+				hitRecord.originX[lane] = packet.origin.x + packet.directionX[lane] * t;
+				hitRecord.originY[lane] = packet.origin.y + packet.directionY[lane] * t;
+				hitRecord.originZ[lane] = packet.origin.z + packet.directionZ[lane] * t;
+				hitRecord.normalX[lane] = normal.x;
+				hitRecord.normalY[lane] = normal.y;
+				hitRecord.normalZ[lane] = normal.z;
+				hitRecord.materialIndex[lane] = materialIndex;
+			}
+			hitRecord.hitMask |= hitMask;
+			return hitMask;
+		}
+
+		template<int Lanes>
+		inline uint32_t HitTest_Triangle(const Triangle& triangle, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& hitRecord)
+		{
+			return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.normal, triangle.cullMode, triangle.materialIndex, packet, hitRecord);
+		}
+
+		//Packet in mesh space, see the single ray version
+		template<int Lanes>
+		inline uint32_t HitTest_TriangleMesh(const TriangleMesh& mesh, const RayPacket<Lanes>& packet, PacketHitRecord<Lanes>& hitRecord)
+		{
+			const auto& triangleIndices = mesh.bvh.GetPrimitiveIndices();
+
+			uint32_t hitMask{};
+			mesh.bvh.IntersectPacket(packet, hitRecord.t, [&](uint32_t first, uint32_t count)
+				{
+					for (uint32_t index{ first }; index < first + count; ++index)
+					{
+						const uint32_t triangleIndex{ triangleIndices[index] };
+						const int* pIndices{ &mesh.indices[triangleIndex * 3] };
+
+						hitMask |= HitTest_Triangle(mesh.positions[pIndices[0]], mesh.positions[pIndices[1]], mesh.positions[pIndices[2]],
+							mesh.normals[triangleIndex], mesh.cullMode, mesh.materialIndex, packet, hitRecord);
+					}
+				});
+			return hitMask;
+		}
 #pragma endregion
 	}
 
 	namespace LightUtils
 	{
 		//Direction from target to light
+		//Point lights: not normalized, the magnitude is the distance to the light
 		inline Vector3 GetDirectionToLight(const Light& light, const Vector3 origin)
 		{
-			//todo W3
-			assert(false && "No Implemented Yet!");
-			return {};
+			if (light.type == LightType::Directional)
+				return -light.direction;
+
+			return light.origin - origin;
 		}
 
 		inline ColorRGB GetRadiance(const Light& light, const Vector3& target)
 		{
-			//todo W3
-			assert(false && "No Implemented Yet!");
-			return {};
+			if (light.type == LightType::Directional)
+				return light.color * light.intensity;
+
+			return light.color * (light.intensity / (light.origin - target).SqrMagnitude());
 		}
 	}
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
+		//Positions and indices through the OBJLoader, plus the one normal per triangle TriangleMesh expects
+		//Faces referencing vt/vn can split a position into several vertices, their extra attributes are dropped here
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, ThreadPool* pThreadPool = nullptr)
 		{
-			std::ifstream file(filename);
-			if (!file)
+			OBJMesh mesh{};
+			if (!OBJLoader::Load(filename, mesh, pThreadPool))
 				return false;
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
+			positions = std::move(mesh.positions);
+			indices = std::move(mesh.indices);
 
 			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
+			normals.resize(indices.size() / 3);
+			for (size_t triangleIndex = 0; triangleIndex < normals.size(); ++triangleIndex)
 			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
+				const Vector3& v0 = positions[indices[triangleIndex * 3]];
+				const Vector3& v1 = positions[indices[triangleIndex * 3 + 1]];
+				const Vector3& v2 = positions[indices[triangleIndex * 3 + 2]];
 
-				normals.push_back(normal);
+				normals[triangleIndex] = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
 			}
 
 			return true;
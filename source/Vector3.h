@@ -1,8 +1,14 @@
 #pragma once
+#include <cassert>
+#include <cmath>
 
 namespace dae
 {
 	struct Vector4;
+
+	//Everything is inline so the hot paths get it inlined without LTO
+	//Stays scalar: 12 bytes don't fill an SSE register and the loads/stores would cost more than the 3 lanes save,
+	//the compiler vectorizes neighbouring operations on its own. Vector4 and Matrix are the SIMD backed ones.
 	struct Vector3
 	{
 		float x{};
@@ -10,38 +16,139 @@ namespace dae
 		float z{};
 
 		Vector3() = default;
-		Vector3(float _x, float _y, float _z);
-		Vector3(const Vector3& from, const Vector3& to);
+		Vector3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
+		//Defined in Vector4.h
 		Vector3(const Vector4& v);
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector3 Normalized() const;
+		float Magnitude() const
+		{
+			return sqrtf(x * x + y * y + z * z);
+		}
+
+		float SqrMagnitude() const
+		{
+			return x * x + y * y + z * z;
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+
+			return m;
+		}
+
+		Vector3 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m };
+		}
+
+		static float Dot(const Vector3& v1, const Vector3& v2)
+		{
+			return { v1.x * v2.x + v1.y * v2.y + v1.z * v2.z };
+		}
+
+		static Vector3 Cross(const Vector3& v1, const Vector3& v2)
+		{
+			return { Vector3{ v1.y * v2.z - v2.y * v1.z, -v1.x * v2.z + v2.x * v1.z, v1.x * v2.y - v2.x * v1.y } };
+		}
+
+		static Vector3 Project(const Vector3& v1, const Vector3& v2)
+		{
+			return (v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static Vector3 Reject(const Vector3& v1, const Vector3& v2)
+		{
+			return (v1 - v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
 
-		static float Dot(const Vector3& v1, const Vector3& v2);
-		static Vector3 Cross(const Vector3& v1, const Vector3& v2);
-		static Vector3 Project(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reject(const Vector3& v1, const Vector3& v2);
 		static Vector3 Reflect(const Vector3& v1, const Vector3& v2);
 		static Vector3 Lico(float f1, const Vector3& v1, float f2, const Vector3& v2, float f3, const Vector3& v3);
 
+		//Defined in Vector4.h
 		Vector4 ToPoint4() const;
 		Vector4 ToVector4() const;
 
 		//Member Operators
-		Vector3 operator*(float scale) const;
-		Vector3 operator/(float scale) const;
-		Vector3 operator+(const Vector3& v) const;
-		Vector3 operator-(const Vector3& v) const;
-		Vector3 operator-() const;
-		//Vector3& operator-();
-		Vector3& operator+=(const Vector3& v);
-		Vector3& operator-=(const Vector3& v);
-		Vector3& operator/=(float scale);
-		Vector3& operator*=(float scale);
-		float& operator[](int index);
-		float operator[](int index) const;
+		Vector3 operator*(float scale) const
+		{
+			return { x * scale, y * scale, z * scale };
+		}
+
+		Vector3 operator/(float scale) const
+		{
+			return { x / scale, y / scale, z / scale };
+		}
+
+		Vector3 operator+(const Vector3& v) const
+		{
+			return { x + v.x, y + v.y, z + v.z };
+		}
+
+		Vector3 operator-(const Vector3& v) const
+		{
+			return { x - v.x, y - v.y, z - v.z };
+		}
+
+		Vector3 operator-() const
+		{
+			return { -x, -y, -z };
+		}
+
+		Vector3& operator+=(const Vector3& v)
+		{
+			x += v.x;
+			y += v.y;
+			z += v.z;
+			return *this;
+		}
+
+		Vector3& operator-=(const Vector3& v)
+		{
+			x -= v.x;
+			y -= v.y;
+			z -= v.z;
+			return *this;
+		}
+
+		Vector3& operator/=(float scale)
+		{
+			x /= scale;
+			y /= scale;
+			z /= scale;
+			return *this;
+		}
+
+		Vector3& operator*=(float scale)
+		{
+			x *= scale;
+			y *= scale;
+			z *= scale;
+			return *this;
+		}
+
+		float& operator[](int index)
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+
+		float operator[](int index) const
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
 
 		static const Vector3 UnitX;
 		static const Vector3 UnitY;
@@ -49,9 +156,19 @@ namespace dae
 		static const Vector3 Zero;
 	};
 
+	inline const Vector3 Vector3::UnitX{ 1, 0, 0 };
+	inline const Vector3 Vector3::UnitY{ 0, 1, 0 };
+	inline const Vector3 Vector3::UnitZ{ 0, 0, 1 };
+	inline const Vector3 Vector3::Zero{ 0, 0, 0 };
+
 	//Global Operators
 	inline Vector3 operator*(float scale, const Vector3& v)
 	{
 		return { v.x * scale, v.y * scale, v.z * scale };
 	}
+
+	inline Vector3 Vector3::Reflect(const Vector3& v1, const Vector3& v2)
+	{
+		return v1 - (2.f * Vector3::Dot(v1, v2) * v2);
+	}
 }
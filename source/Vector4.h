@@ -1,9 +1,15 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+
+#include "SIMD.h"
+#include "Vector3.h"
 
 namespace dae
 {
-	struct Vector3;
-	struct Vector4
+	//SSE backed on x64 (SSE2 is part of the x64 baseline, so no runtime check), scalar elsewhere
+	//Lanes are summed in x, y, z, w order like the scalar code, so both round the same
+	struct alignas(16) Vector4
 	{
 		float x;
 		float y;
@@ -11,22 +17,131 @@ namespace dae
 		float w;
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
+		Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+#if DAE_SIMD_X64
+		explicit Vector4(__m128 v)
+		{
+			_mm_store_ps(&x, v);
+		}
+
+		__m128 Load() const
+		{
+			return _mm_load_ps(&x);
+		}
+#endif
+
+		float Magnitude() const
+		{
+			return sqrtf(SqrMagnitude());
+		}
+
+		float SqrMagnitude() const
+		{
+			return Dot(*this, *this);
+		}
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector4 Normalized() const;
+		float Normalize()
+		{
+			const float m = Magnitude();
+			*this = *this / m;
 
-		static float Dot(const Vector4& v1, const Vector4& v2);
+			return m;
+		}
+
+		Vector4 Normalized() const
+		{
+			return *this / Magnitude();
+		}
+
+		static float Dot(const Vector4& v1, const Vector4& v2)
+		{
+#if DAE_SIMD_X64
+			const __m128 products{ _mm_mul_ps(v1.Load(), v2.Load()) };
+			__m128 sum{ _mm_add_ss(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(1, 1, 1, 1))) };
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 2, 2, 2)));
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(products, products, _MM_SHUFFLE(3, 3, 3, 3)));
+			return _mm_cvtss_f32(sum);
+#else
+			return { v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w };
+#endif
+		}
 
 		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
+		Vector4 operator*(float scale) const
+		{
+#if DAE_SIMD_X64
+			return Vector4{ _mm_mul_ps(Load(), _mm_set1_ps(scale)) };
+#else
+			return { x * scale, y * scale, z * scale, w * scale };
+#endif
+		}
+
+		Vector4 operator/(float scale) const
+		{
+#if DAE_SIMD_X64
+			return Vector4{ _mm_div_ps(Load(), _mm_set1_ps(scale)) };
+#else
+			return { x / scale, y / scale, z / scale, w / scale };
+#endif
+		}
+
+		Vector4 operator+(const Vector4& v) const
+		{
+#if DAE_SIMD_X64
+			return Vector4{ _mm_add_ps(Load(), v.Load()) };
+#else
+			return { x + v.x, y + v.y, z + v.z, w + v.w };
+#endif
+		}
+
+		Vector4 operator-(const Vector4& v) const
+		{
+#if DAE_SIMD_X64
+			return Vector4{ _mm_sub_ps(Load(), v.Load()) };
+#else
+			return { x - v.x, y - v.y, z - v.z, w - v.w };
+#endif
+		}
+
+		Vector4& operator+=(const Vector4& v)
+		{
+			*this = *this + v;
+			return *this;
+		}
+
+		float& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		float operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
 	};
+
+	//Vector3 members that need the complete Vector4
+	inline Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	inline Vector4 Vector3::ToPoint4() const
+	{
+		return { x, y, z, 1 };
+	}
+
+	inline Vector4 Vector3::ToVector4() const
+	{
+		return { x, y, z, 0 };
+	}
 }
@@ -1,85 +1,288 @@
 //External includes
+#ifdef _MSC_VER
 #include "vld.h"
+#endif
 #include "SDL.h"
 #include "SDL_surface.h"
 #undef main
 
 //Standard includes
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <string>
+#include <vector>
 
 //Project includes
+#include "Benchmark.h"
+#include "Profiler.h"
 #include "Timer.h"
 #include "Renderer.h"
+#include "RenderThread.h"
 #include "Scene.h"
 
 using namespace dae;
 
 void ShutDown(SDL_Window* pWindow)
 {
-	SDL_DestroyWindow(pWindow);
+	if (pWindow)
+		SDL_DestroyWindow(pWindow);
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+//Converts the last finished frame straight into the window surface,
+//windows that don't use a 32 bit (A/X)RGB or (A/X)BGR format go through a scratch buffer and SDL_ConvertPixels
+void Present(SDL_Window* pWindow, const Renderer* pRenderer)
+{
+	SDL_Surface* pSurface = SDL_GetWindowSurface(pWindow);
+	const uint32_t format = pSurface->format->format;
+	if (format == SDL_PIXELFORMAT_ARGB8888 || format == SDL_PIXELFORMAT_RGB888)
+	{
+		pRenderer->ConvertFrontBuffer(static_cast<uint32_t*>(pSurface->pixels), pSurface->pitch, PixelFormat::ARGB8888);
+	}
+	else if (format == SDL_PIXELFORMAT_ABGR8888 || format == SDL_PIXELFORMAT_BGR888)
+	{
+		pRenderer->ConvertFrontBuffer(static_cast<uint32_t*>(pSurface->pixels), pSurface->pitch, PixelFormat::ABGR8888);
+	}
+	else
+	{
+		static std::vector<uint32_t> pixels{};
+		pixels.resize(size_t(pRenderer->GetWidth()) * pRenderer->GetHeight());
+		pRenderer->ConvertFrontBuffer(pixels.data(), pRenderer->GetWidth() * 4);
+
+		SDL_ConvertPixels(pRenderer->GetWidth(), pRenderer->GetHeight(),
+			SDL_PIXELFORMAT_ARGB8888, pixels.data(), pRenderer->GetWidth() * 4,
+			format, pSurface->pixels, pSurface->pitch);
+	}
+
+	SDL_UpdateWindowSurface(pWindow);
+}
+
+CameraInput ReadCameraInput()
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	CameraInput input{};
 
-	//Create window + surfaces
-	SDL_Init(SDL_INIT_VIDEO);
+	const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
+	input.moveForward = pKeyboardState[SDL_SCANCODE_W] || pKeyboardState[SDL_SCANCODE_UP];
+	input.moveBackward = pKeyboardState[SDL_SCANCODE_S] || pKeyboardState[SDL_SCANCODE_DOWN];
+	input.moveLeft = pKeyboardState[SDL_SCANCODE_A] || pKeyboardState[SDL_SCANCODE_LEFT];
+	input.moveRight = pKeyboardState[SDL_SCANCODE_D] || pKeyboardState[SDL_SCANCODE_RIGHT];
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
+	const uint32_t mouseState = SDL_GetRelativeMouseState(&input.mouseX, &input.mouseY);
+	input.isLeftMouseDown = mouseState & SDL_BUTTON(SDL_BUTTON_LEFT);
+	input.isRightMouseDown = mouseState & SDL_BUTTON(SDL_BUTTON_RIGHT);
 
-	SDL_Window* pWindow = SDL_CreateWindow(
-		"RayTracer - **Jelle Adyns**",
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+	return input;
+}
 
-	if (!pWindow)
+//Renders a fixed number of frames without a window and writes the last one to disk
+int RunHeadless(Scene* pScene, Renderer* pRenderer, Timer* pTimer, int numFrames, const std::string& outputPath)
+{
+	pTimer->Start();
+	for (int frame = 0; frame < numFrames; ++frame)
+	{
+		DAE_PROFILE_ZONE("Frame");
+		pScene->Update(pTimer);
+		pRenderer->Render(pScene);
+		pTimer->Update();
+	}
+	std::cout << "Rendered " << numFrames << " frame(s) in " << pTimer->GetTotal() << "s" << std::endl;
+	pTimer->Stop();
+
+	if (!pRenderer->SaveBufferToImage(outputPath.c_str()))
+	{
+		std::cout << "Something went wrong. " << outputPath << " not saved!" << std::endl;
 		return 1;
+	}
+
+	std::cout << "Saved " << outputPath << std::endl;
+	return 0;
+}
+
+bool WriteTrace(const std::string& tracePath)
+{
+	if (!Profiler::WriteChromeTrace(tracePath))
+	{
+		std::cout << "Something went wrong. " << tracePath << " not saved!" << std::endl;
+		return false;
+	}
+
+	std::cout << "Saved " << tracePath << std::endl;
+	return true;
+}
+
+int main(int argc, char* args[])
+{
+	//Command line
+	uint32_t numThreads = 0; //0 = one thread per hardware core
+	int packetSize = 4; //1 = no packets
+	std::string sceneName = "W1";
+	bool isHeadless = false; //no window, render numFrames frames to outputPath and exit
+	int numFrames = 1;
+	std::string outputPath = "RayTracing_Buffer.bmp";
+	int width = 640;
+	int height = 480;
+	bool isProgressive = false; //accumulate samples while nothing moves
+	bool isAntiAliased = false; //extra samples on edges only
+	bool isWavefront = false; //stage by stage over the whole frame instead of pixel by pixel
+	float targetFrameTime = 0.f; //ms, 0 = always trace at the window size
+	int numBenchmarkFrames = 0; //record this many frames after a warmup, then report them and write benchmark.json
+	std::string tracePath{}; //Chrome trace of the last frames, written on exit (needs RAYTRACER_PROFILING)
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		const std::string arg = args[argIndex];
+		if ((arg == "-t" || arg == "--threads") && argIndex + 1 < argc)
+			numThreads = static_cast<uint32_t>(std::stoul(args[++argIndex]));
+		else if ((arg == "-p" || arg == "--packet") && argIndex + 1 < argc)
+			packetSize = std::stoi(args[++argIndex]);
+		else if ((arg == "-s" || arg == "--scene") && argIndex + 1 < argc)
+			sceneName = args[++argIndex];
+		else if (arg == "--headless")
+			isHeadless = true;
+		else if ((arg == "-f" || arg == "--frames") && argIndex + 1 < argc)
+			numFrames = std::max(std::stoi(args[++argIndex]), 1);
+		else if ((arg == "-o" || arg == "--output") && argIndex + 1 < argc)
+			outputPath = args[++argIndex];
+		else if (arg == "--width" && argIndex + 1 < argc)
+			width = std::stoi(args[++argIndex]);
+		else if (arg == "--height" && argIndex + 1 < argc)
+			height = std::stoi(args[++argIndex]);
+		else if (arg == "--progressive")
+			isProgressive = true;
+		else if (arg == "--aa")
+			isAntiAliased = true;
+		else if (arg == "--wavefront")
+			isWavefront = true;
+		else if (arg == "--target-ms" && argIndex + 1 < argc)
+			targetFrameTime = std::stof(args[++argIndex]);
+		else if (arg == "--benchmark" && argIndex + 1 < argc)
+			numBenchmarkFrames = std::max(std::stoi(args[++argIndex]), 0);
+		else if (arg == "--trace" && argIndex + 1 < argc)
+			tracePath = args[++argIndex];
+	}
+
+	if (!tracePath.empty() && !Profiler::IS_ENABLED)
+	{
+		std::cout << "Built without RAYTRACER_PROFILING, --trace ignored" << std::endl;
+		tracePath.clear();
+	}
+
+	//Create window + surfaces, headless runs never touch the video subsystem
+	SDL_Window* pWindow = nullptr;
+	if (!isHeadless)
+	{
+		SDL_Init(SDL_INIT_VIDEO);
+
+		pWindow = SDL_CreateWindow(
+			"RayTracer - **Jelle Adyns**",
+			SDL_WINDOWPOS_UNDEFINED,
+			SDL_WINDOWPOS_UNDEFINED,
+			width, height, 0);
+
+		if (!pWindow)
+			return 1;
+	}
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(width, height);
+	pRenderer->SetThreadCount(numThreads);
+	pRenderer->SetPacketSize(packetSize);
+	pRenderer->SetProgressive(isProgressive);
+	pRenderer->SetAdaptiveAntiAliasing(isAntiAliased);
+	pRenderer->SetWavefront(isWavefront);
+	pRenderer->SetTargetFrameTime(targetFrameTime);
+	std::cout << "Render threads: " << pRenderer->GetThreadCount() << std::endl;
 
-	const auto pScene = new Scene_W1();
+	Scene* pScene = Scene::CreateByName(sceneName);
+	if (!pScene)
+	{
+		std::cout << "Unknown scene " << sceneName << ", rendering W1" << std::endl;
+		pScene = new Scene_W1();
+	}
 	pScene->Initialize();
 
+	if (isHeadless)
+	{
+		int result = RunHeadless(pScene, pRenderer, pTimer, numFrames, outputPath);
+		if (!tracePath.empty() && !WriteTrace(tracePath))
+			result = 1;
+
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return result;
+	}
+
+	//Traces each frame while the last one gets presented, so the window shows frames one behind
+	RenderThread* pRenderThread = new RenderThread(pRenderer);
+
 	//Start loop
 	pTimer->Start();
 
-	// Start Benchmark
-	 pTimer->StartBenchmark();
+	//Frame times include presenting, unlike the headless RayTracerBenchmark
+	constexpr int numBenchmarkWarmupFrames = 10;
+	FrameStats benchmarkStats{ numBenchmarkWarmupFrames };
+	bool isBenchmarking = numBenchmarkFrames > 0;
 
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
 	while (isLooping)
 	{
+		DAE_PROFILE_ZONE("Frame");
+		const auto frameStart = std::chrono::steady_clock::now();
+
 		//--------- Get input events ---------
-		SDL_Event e;
-		while (SDL_PollEvent(&e))
 		{
-			switch (e.type)
+			DAE_PROFILE_ZONE("Input");
+			SDL_Event e;
+			while (SDL_PollEvent(&e))
 			{
-			case SDL_QUIT:
-				isLooping = false;
-				break;
-			case SDL_KEYUP:
-				if(e.key.keysym.scancode == SDL_SCANCODE_X)
-					takeScreenshot = true;
-				break;
+				switch (e.type)
+				{
+				case SDL_QUIT:
+					isLooping = false;
+					break;
+				case SDL_KEYUP:
+					if(e.key.keysym.scancode == SDL_SCANCODE_X)
+						takeScreenshot = true;
+					break;
+				}
 			}
+			pScene->GetCamera().input = ReadCameraInput();
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		{
+			DAE_PROFILE_ZONE("Scene::Update");
+			pScene->Update(pTimer);
+		}
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		pRenderThread->Start(pScene);
+		{
+			DAE_PROFILE_ZONE("Present");
+			Present(pWindow, pRenderer);
+		}
+		pRenderThread->Wait();
+
+		if (isBenchmarking)
+		{
+			benchmarkStats.AddFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count(), pRenderer->GetPrimaryRayCount(), pRenderer->GetRayCounters());
+			if (benchmarkStats.GetFrameCount() >= static_cast<size_t>(numBenchmarkFrames))
+			{
+				isBenchmarking = false;
+
+				BenchmarkReport report{};
+				report.AddRun({ sceneName, width, height, pRenderer->GetThreadCount(), pRenderer->GetPacketSize(), "interactive", benchmarkStats });
+				report.Print(std::cout);
+				if (!report.WriteJson("benchmark.json"))
+					std::cout << "Something went wrong. benchmark.json not saved!" << std::endl;
+			}
+		}
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -87,13 +290,18 @@ int main(int argc, char* args[])
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS();
+			if (pRenderer->GetTargetFrameTime() > 0.f)
+				std::cout << ", resolution scale: " << pRenderer->GetResolutionScale();
+			if (pRenderer->IsProgressive())
+				std::cout << ", samples: " << pRenderer->GetAccumulatedFrameCount() << ", converged: " << pRenderer->GetConvergedFraction() * 100.f << "%";
+			std::cout << std::endl;
 		}
 
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
+			if (pRenderer->SaveBufferToImage())
 				std::cout << "Screenshot saved!" << std::endl;
 			else
 				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
@@ -101,6 +309,9 @@ int main(int argc, char* args[])
 		}
 	}
 	pTimer->Stop();
+	delete pRenderThread;
+
+	const bool isTraceWritten = tracePath.empty() || WriteTrace(tracePath);
 
 	//Shutdown "framework"
 	delete pScene;
@@ -108,5 +319,5 @@ int main(int argc, char* args[])
 	delete pTimer;
 
 	ShutDown(pWindow);
-	return 0;
+	return isTraceWritten ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,361 @@
+//Checks for the claims the optimized paths rest on: they have to produce the same bits as the plain ones
+//One executable, the test to run is the first argument (CMake registers each one with add_test)
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ColorQuantizer.h"
+#include "Matrix.h"
+#include "OBJLoader.h"
+#include "RayPacket.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SIMD.h"
+#include "ThreadPool.h"
+
+using namespace dae;
+
+namespace
+{
+	int g_NumFailures = 0;
+
+	void Check(bool condition, const std::string& message)
+	{
+		if (condition)
+			return;
+
+		++g_NumFailures;
+		std::cout << "FAILED: " << message << std::endl;
+	}
+
+	bool AreIdentical(const Vector3& v1, const Vector3& v2)
+	{
+		return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
+	}
+
+	std::unique_ptr<Scene> CreateScene(const std::string& sceneName)
+	{
+		std::unique_ptr<Scene> pScene{ Scene::CreateByName(sceneName) };
+		pScene->Initialize();
+		pScene->UpdateAccelerationStructures();
+		return pScene;
+	}
+
+	std::vector<uint32_t> RenderImage(Scene* pScene, uint32_t numThreads, int packetSize, bool isWavefront = false)
+	{
+		constexpr int width = 160;
+		constexpr int height = 120;
+
+		Renderer renderer{ width, height };
+		renderer.SetThreadCount(numThreads);
+		renderer.SetPacketSize(packetSize);
+		renderer.SetWavefront(isWavefront);
+		renderer.Render(pScene);
+
+		std::vector<uint32_t> pixels(size_t(width) * height);
+		renderer.ConvertFrontBuffer(pixels.data(), width * static_cast<int>(sizeof(uint32_t)));
+		return pixels;
+	}
+
+	std::vector<SIMD::InstructionSet> GetSupportedInstructionSets()
+	{
+		std::vector<SIMD::InstructionSet> instructionSets{};
+		for (const SIMD::InstructionSet instructionSet : { SIMD::InstructionSet::Scalar, SIMD::InstructionSet::AVX2, SIMD::InstructionSet::AVX512 })
+		{
+			if (instructionSet <= SIMD::GetInstructionSet())
+				instructionSets.push_back(instructionSet);
+		}
+		return instructionSets;
+	}
+}
+
+//Tiles are independent, so the thread count must not change a single pixel
+void TestRenderThreads()
+{
+	for (const std::string& sceneName : Scene::GetSceneNames())
+	{
+		std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+		const std::vector<uint32_t> serialImage{ RenderImage(pScene.get(), 1, 4) };
+		for (const uint32_t numThreads : { 2u, 4u, 7u })
+		{
+			Check(RenderImage(pScene.get(), numThreads, 4) == serialImage, sceneName + ": " + std::to_string(numThreads) + " threads differ from 1 thread");
+		}
+		Check(RenderImage(pScene.get(), 4, 4, true) == serialImage, sceneName + ": wavefront differs from tiles");
+	}
+}
+
+template<int Lanes>
+void CheckPacketHits(const Scene& scene, const std::string& sceneName, const RayPacket<Lanes>& packet)
+{
+	PacketHitRecord<Lanes> packetHits{};
+	scene.GetClosestHit(packet, packetHits);
+
+	for (int lane = 0; lane < Lanes; ++lane)
+	{
+		HitRecord hit{};
+		scene.GetClosestHit(packet.GetRay(lane), hit);
+
+		const HitRecord packetHit{ packetHits.GetHitRecord(lane) };
+		bool isSame = packetHit.didHit == hit.didHit;
+		if (hit.didHit)
+		{
+			isSame &= packetHit.t == hit.t && packetHit.materialIndex == hit.materialIndex
+				&& AreIdentical(packetHit.origin, hit.origin) && AreIdentical(packetHit.normal, hit.normal);
+		}
+
+		std::ostringstream message{};
+		message << sceneName << ": " << Lanes << " lane packet, lane " << lane << " hits differently than the single ray";
+		Check(isSame, message.str());
+	}
+}
+
+//Packets over the whole view, square like the renderer's and spread wider so some are incoherent
+template<int Lanes>
+void CheckPacketHits(const Scene& scene, const std::string& sceneName, const Camera& camera, float spread)
+{
+	constexpr int packetSize = Lanes == 4 ? 2 : 4;
+	constexpr int numPackets = 24;
+
+	const Matrix cameraToWorld{ Matrix{ camera.right, camera.up, camera.forward, camera.origin } };
+	for (int packetY = 0; packetY < numPackets; ++packetY)
+	{
+		for (int packetX = 0; packetX < numPackets; ++packetX)
+		{
+			RayPacket<Lanes> packet{};
+			packet.origin = camera.origin;
+			packet.activeMask = Lanes == 32 ? ~0u : (1u << Lanes) - 1;
+			for (int lane = 0; lane < Lanes; ++lane)
+			{
+				const float x = (packetX + float(lane % packetSize) * spread) / numPackets * 2.f - 1.f;
+				const float y = 1.f - (packetY + float(lane / packetSize) * spread) / numPackets * 2.f;
+				packet.SetDirection(lane, cameraToWorld.TransformVector(x, y, 1.f).Normalized());
+			}
+			CheckPacketHits(scene, sceneName, packet);
+		}
+	}
+}
+
+//Packet traversal and the packet intersection kernels against one ray at a time, and the images of every packet size
+void TestPacketHits()
+{
+	for (const std::string& sceneName : Scene::GetSceneNames())
+	{
+		std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+		Camera& camera{ pScene->GetCamera() };
+		camera.CalculateCameraToWorld();
+
+		for (const float spread : { 0.1f, 4.f })
+		{
+			CheckPacketHits<4>(*pScene, sceneName, camera, spread);
+			CheckPacketHits<16>(*pScene, sceneName, camera, spread);
+		}
+
+		const std::vector<uint32_t> singleRayImage{ RenderImage(pScene.get(), 1, 1) };
+		for (const int packetSize : { 2, 4 })
+		{
+			Check(RenderImage(pScene.get(), 1, packetSize) == singleRayImage, sceneName + ": packet size " + std::to_string(packetSize) + " image differs from single rays");
+		}
+	}
+}
+
+//Every row width up to a few vectors, so the SIMD tails are covered
+//Radiance up to 2 so about half the colors get max-normalized, never negative like the renderer's
+void TestQuantizer()
+{
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ 0.f, 2.f };
+	std::vector<ColorRGB> colors(257);
+	for (ColorRGB& color : colors)
+		color = { distribution(random), distribution(random), distribution(random) };
+	colors[0] = { 0.f, 0.f, 0.f };
+	colors[1] = { 1.f, 1.f, 1.f };
+
+	for (const PixelFormat format : { PixelFormat::ARGB8888, PixelFormat::ABGR8888 })
+	{
+		ColorQuantizer scalarQuantizer{ format };
+		scalarQuantizer.SetInstructionSet(SIMD::InstructionSet::Scalar);
+
+		for (const SIMD::InstructionSet instructionSet : GetSupportedInstructionSets())
+		{
+			ColorQuantizer quantizer{ format };
+			quantizer.SetInstructionSet(instructionSet);
+
+			for (int width = 1; width <= static_cast<int>(colors.size()); width += width < 70 ? 1 : 31)
+			{
+				std::vector<uint32_t> scalarPixels(width);
+				std::vector<uint32_t> pixels(width);
+				scalarQuantizer.QuantizeRow(colors.data(), scalarPixels.data(), width);
+				quantizer.QuantizeRow(colors.data(), pixels.data(), width);
+
+				std::ostringstream message{};
+				message << "Quantizer " << SIMD::GetInstructionSetName(instructionSet) << " differs from scalar, format " << static_cast<int>(format) << ", width " << width;
+				Check(pixels == scalarPixels, message.str());
+			}
+		}
+	}
+}
+
+//Multiply and the batch transforms against the plain row * column formulas
+void TestMatrix()
+{
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ -10.f, 10.f };
+	const auto createMatrix = [&]()
+		{
+			return Matrix::CreateScale(distribution(random), distribution(random), distribution(random))
+				* Matrix::CreateRotation(distribution(random), distribution(random), distribution(random))
+				* Matrix::CreateTranslation(distribution(random), distribution(random), distribution(random));
+		};
+
+	for (int round = 0; round < 100; ++round)
+	{
+		const Matrix a{ createMatrix() };
+		const Matrix b{ createMatrix() };
+
+		Matrix expected{};
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+				expected[r][c] = a[r].x * b[0][c] + a[r].y * b[1][c] + a[r].z * b[2][c] + a[r].w * b[3][c];
+		}
+		Check(a * b == expected, "Matrix multiply differs from the scalar formula");
+
+		Matrix product{ a };
+		product *= b;
+		Check(product == expected, "Matrix *= differs from operator*");
+	}
+
+	const Matrix transform{ createMatrix() };
+	std::vector<Vector3> points(1000);
+	for (Vector3& point : points)
+		point = { distribution(random), distribution(random), distribution(random) };
+
+	for (const SIMD::InstructionSet instructionSet : GetSupportedInstructionSets())
+	{
+		//Counts around the 8 wide AVX2 kernel, so partial batches are covered
+		for (const size_t count : { size_t(0), size_t(1), size_t(7), size_t(8), size_t(9), size_t(17), points.size() })
+		{
+			std::vector<Vector3> transformedPoints(count);
+			std::vector<Vector3> transformedVectors(count);
+			transform.TransformPoints(points.data(), transformedPoints.data(), count, instructionSet);
+			transform.TransformVectors(points.data(), transformedVectors.data(), count, instructionSet);
+
+			bool isSame = true;
+			for (size_t index = 0; index < count; ++index)
+			{
+				const Vector3& p{ points[index] };
+				const Vector3 expectedPoint{
+					transform[0].x * p.x + transform[1].x * p.y + transform[2].x * p.z + transform[3].x,
+					transform[0].y * p.x + transform[1].y * p.y + transform[2].y * p.z + transform[3].y,
+					transform[0].z * p.x + transform[1].z * p.y + transform[2].z * p.z + transform[3].z };
+				isSame &= AreIdentical(transformedPoints[index], expectedPoint) && AreIdentical(transformedPoints[index], transform.TransformPoint(p));
+				isSame &= AreIdentical(transformedVectors[index], transform.TransformVector(p));
+			}
+
+			std::ostringstream message{};
+			message << "Matrix batch transform " << SIMD::GetInstructionSetName(instructionSet) << " differs from single transforms, count " << count;
+			Check(isSame, message.str());
+		}
+	}
+}
+
+//A grid of quads written row by row with only relative (negative) v/vt/vn indices into the previous row,
+//large enough that a pool splits it into several chunks, so many faces reference attributes another chunk parsed
+void TestOBJChunks()
+{
+	constexpr int gridSize = 400;
+	constexpr int rowSize = gridSize + 1;
+
+	std::ostringstream text{};
+	text << "# relative index grid\n";
+	for (int row = 0; row <= gridSize; ++row)
+	{
+		text << "vn 0 " << row << " 1\n";
+		for (int column = 0; column <= gridSize; ++column)
+			text << "v " << column << " " << row << " 0\nvt " << column << " " << row << "\n";
+
+		if (row == 0)
+			continue;
+		for (int column = 0; column < gridSize; ++column)
+		{
+			const int v0 = -(2 * rowSize - column), v1 = v0 + 1, v2 = -(rowSize - column) + 1, v3 = v2 - 1;
+			text << "f " << v0 << "/" << v0 << "/-2 " << v1 << "/" << v1 << "/-2 " << v2 << "/" << v2 << "/-1 " << v3 << "/" << v3 << "/-1\n";
+		}
+	}
+	const std::string objText{ text.str() };
+	Check(objText.size() > (size_t(4) << 20), "OBJ test text is too small to be split into chunks");
+
+	OBJMesh serialMesh{};
+	Check(OBJLoader::Parse(objText.data(), objText.size(), serialMesh), "Serial OBJ parse failed");
+
+	ThreadPool threadPool{ 4 };
+	OBJMesh mesh{};
+	Check(OBJLoader::Parse(objText.data(), objText.size(), mesh, &threadPool), "Chunked OBJ parse failed");
+
+	Check(mesh.GetTriangleCount() == size_t(2) * gridSize * gridSize, "OBJ triangle count is wrong");
+	Check(mesh.indices == serialMesh.indices && mesh.positions.size() == serialMesh.positions.size()
+		&& std::equal(mesh.positions.begin(), mesh.positions.end(), serialMesh.positions.begin(), AreIdentical),
+		"Chunked OBJ parse differs from the serial one");
+	if (mesh.GetTriangleCount() != size_t(2) * gridSize * gridSize || mesh.normals.size() != mesh.positions.size() || mesh.texCoords.size() != mesh.positions.size())
+		return;
+
+	//Quad (row, column) is fan triangulated into (v0, v1, v2) and (v0, v2, v3), the first two corners in the row below
+	int numWrongCorners = 0;
+	for (size_t triangleIndex = 0; triangleIndex < mesh.GetTriangleCount(); ++triangleIndex)
+	{
+		const int quadIndex = static_cast<int>(triangleIndex / 2);
+		const int row = quadIndex / gridSize + 1;
+		const int column = quadIndex % gridSize;
+		const int cornerColumns[2][3]{ { column, column + 1, column + 1 }, { column, column + 1, column } };
+		const int cornerRows[2][3]{ { row - 1, row - 1, row }, { row - 1, row, row } };
+
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			const int vertex = mesh.indices[triangleIndex * 3 + corner];
+			const float x = float(cornerColumns[triangleIndex % 2][corner]);
+			const float y = float(cornerRows[triangleIndex % 2][corner]);
+			const bool isRight = AreIdentical(mesh.positions[vertex], { x, y, 0.f })
+				&& mesh.texCoords[vertex].u == x && mesh.texCoords[vertex].v == y
+				&& AreIdentical(mesh.normals[vertex], { 0.f, float(y == row ? row : row - 1), 1.f });
+			numWrongCorners += isRight ? 0 : 1;
+		}
+	}
+	Check(numWrongCorners == 0, "OBJ has " + std::to_string(numWrongCorners) + " corners with the wrong position, texCoord or normal");
+}
+
+int main(int argc, char* args[])
+{
+	const std::vector<std::pair<std::string, std::function<void()>>> tests{
+		{ "render-threads", TestRenderThreads },
+		{ "packet-hits", TestPacketHits },
+		{ "quantizer", TestQuantizer },
+		{ "matrix", TestMatrix },
+		{ "obj-chunks", TestOBJChunks },
+	};
+
+	//No argument runs all of them
+	const std::string testName = argc > 1 ? args[1] : "";
+	bool isFound = false;
+	for (const auto& [name, test] : tests)
+	{
+		if (!testName.empty() && name != testName)
+			continue;
+
+		isFound = true;
+		std::cout << name << std::endl;
+		test();
+	}
+
+	if (!isFound)
+	{
+		std::cout << "Unknown test " << testName << std::endl;
+		return 1;
+	}
+	return g_NumFailures == 0 ? 0 : 1;
+}